@@ -0,0 +1,180 @@
+//
+// Headless benchmarks for fontstash and stb_truetype.
+//
+// Usage: curio_bench [-d datadir] [-t mintime] [-b baked] [suite...]
+//
+// Results are written to stdout as one JSON object per line:
+//   {"suite":"fontstash","name":"draw_text_warm","font":"DroidSerif-Regular.ttf",
+//    "size":16.0,"value":41.2,"unit":"ns/glyph"}
+//
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+struct bench_font bench_fonts[] =
+{
+	{ "DroidSerif-Regular.ttf", 0, 0, 0, "The quick brown fox jumps over the lazy dog. 0123456789", 0x21, 94 },
+	{ "DroidSerif-Bold.ttf",    0, 0, 0, "The quick brown fox jumps over the lazy dog. 0123456789", 0x21, 94 },
+	{ "DroidSerif-Italic.ttf",  0, 0, 0, "The quick brown fox jumps over the lazy dog. 0123456789", 0x21, 94 },
+	{ "DroidSansJapanese.ttf",  0, 0, 0, "いろはにほへと ちりぬるを 日本語のテキストを描画する", 0x4e00, 256 },
+};
+int bench_nfonts = sizeof(bench_fonts)/sizeof(bench_fonts[0]);
+
+double bench_mintime = 0.25;
+
+unsigned char* bench_baked = NULL;
+int bench_bakedsize = 0;
+
+struct bench_suite
+{
+	const char* name;
+	void (*fn)();
+};
+
+static const struct bench_suite suites[] =
+{
+	{ "fontstash", bench_fontstash },
+	{ "stbtt", bench_stbtt },
+	{ "raster", bench_raster },
+	{ "ex", bench_ex },
+	{ "join", bench_join },
+};
+static const int nsuites = sizeof(suites)/sizeof(suites[0]);
+
+double bench_now()
+{
+	using namespace std::chrono;
+	return duration_cast<duration<double> >(steady_clock::now().time_since_epoch()).count();
+}
+
+void bench_report(const char* suite, const char* name, const char* font, float size,
+				  double value, const char* unit)
+{
+	printf("{\"suite\":\"%s\",\"name\":\"%s\",\"font\":\"%s\",\"size\":%.1f,\"value\":%.4g,\"unit\":\"%s\"}\n",
+		   suite, name, font ? font : "", (double)size, value, unit);
+	fflush(stdout);
+}
+
+int bench_utf8(char* out, unsigned int c)
+{
+	if (c < 0x80) { out[0] = (char)c; return 1; }
+	if (c < 0x800) {
+		out[0] = (char)(0xc0 | (c >> 6));
+		out[1] = (char)(0x80 | (c & 0x3f));
+		return 2;
+	}
+	if (c < 0x10000) {
+		out[0] = (char)(0xe0 | (c >> 12));
+		out[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (c & 0x3f));
+		return 3;
+	}
+	out[0] = (char)(0xf0 | (c >> 18));
+	out[1] = (char)(0x80 | ((c >> 12) & 0x3f));
+	out[2] = (char)(0x80 | ((c >> 6) & 0x3f));
+	out[3] = (char)(0x80 | (c & 0x3f));
+	return 4;
+}
+
+char* bench_range_text(unsigned int first, int count)
+{
+	char* s = (char*)malloc((size_t)count*4+1);
+	int i, n = 0;
+	if (!s) return NULL;
+	for (i = 0; i < count; ++i)
+		n += bench_utf8(s+n, first+(unsigned)i);
+	s[n] = 0;
+	return s;
+}
+
+static unsigned char* load_data(const char* path, int* size)
+{
+	FILE* fp;
+	unsigned char* data;
+	fp = fopen(path, "rb");
+	if (!fp) return NULL;
+	fseek(fp,0,SEEK_END);
+	*size = (int)ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	data = (unsigned char*)malloc((size_t)*size);
+	if (data && fread(data, 1, (size_t)*size, fp) != (size_t)*size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	return data;
+}
+
+static int load_font(struct bench_font* f, const char* dir)
+{
+	char* path = (char*)malloc(strlen(dir)+strlen(f->name)+2);
+	if (!path) return 0;
+	sprintf(path, "%s/%s", dir, f->name);
+	f->path = path;
+	f->data = load_data(path, &f->datasize);
+	return f->data != NULL;
+}
+
+int main(int argc, char** argv)
+{
+	const char* dir = "data";
+	const char* baked = NULL;
+	const char* selected[16];
+	int nselected = 0;
+	int i, j;
+
+	for (i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-d") == 0 && i+1 < argc)
+			dir = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0 && i+1 < argc)
+			bench_mintime = atof(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && i+1 < argc)
+			baked = argv[++i];
+		else if (nselected < 16)
+			selected[nselected++] = argv[i];
+	}
+
+	for (i = 0; i < bench_nfonts; ++i)
+	{
+		if (!load_font(&bench_fonts[i], dir))
+		{
+			fprintf(stderr, "Could not load font %s/%s.\n", dir, bench_fonts[i].name);
+			return 1;
+		}
+	}
+
+	if (baked)
+	{
+		bench_baked = load_data(baked, &bench_bakedsize);
+		if (!bench_baked)
+		{
+			fprintf(stderr, "Could not load baked atlas %s.\n", baked);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < nsuites; ++i)
+	{
+		int run = nselected == 0;
+		for (j = 0; j < nselected; ++j)
+			if (strcmp(selected[j], suites[i].name) == 0) run = 1;
+		if (run)
+			suites[i].fn();
+	}
+
+	for (i = 0; i < bench_nfonts; ++i)
+	{
+		free(bench_fonts[i].data);
+		free((void*)bench_fonts[i].path);
+	}
+	free(bench_baked);
+
+	return 0;
+}
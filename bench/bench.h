@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Shared helpers for the benchmark executable. Each suite is a function that
+// runs its measurements and reports them with bench_report(), which writes
+// one JSON object per line to stdout so runs of different builds can be
+// diffed or loaded into a script.
+
+struct bench_font
+{
+	const char* name;       // file name under the data directory
+	const char* path;
+	unsigned char* data;    // whole file, loaded once at startup
+	int datasize;
+	const char* text;       // representative UTF-8 string for draw/dim
+	unsigned int first;     // contiguous codepoint range with distinct glyphs,
+	int count;              // used wherever every glyph must be a cache miss
+};
+
+extern struct bench_font bench_fonts[];
+extern int bench_nfonts;
+
+// Minimum wall time each measurement is repeated for, in seconds.
+extern double bench_mintime;
+
+// Atlas baked by sthbake for bench_fonts[0], if one was given with -b.
+extern unsigned char* bench_baked;
+extern int bench_bakedsize;
+
+double bench_now();
+
+// Number of blocks allocated with operator new so far, on all threads.
+long bench_allocs();
+
+void bench_report(const char* suite, const char* name, const char* font, float size,
+				  double value, const char* unit);
+
+// Writes the UTF-8 encoding of codepoint to out and returns the byte count.
+int bench_utf8(char* out, unsigned int codepoint);
+
+// Builds a NUL-terminated UTF-8 string of count consecutive codepoints
+// starting at first. The caller frees the result.
+char* bench_range_text(unsigned int first, int count);
+
+// Suites.
+void bench_fontstash();
+void bench_stbtt();
+void bench_raster();
+void bench_ex();
+void bench_join();
+
+#endif // BENCH_H
@@ -0,0 +1,33 @@
+#include "bench.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+// Counts operator new calls for bench_allocs(). Kept in a file of its own so
+// the replacements are not inlined into the code being measured.
+
+static std::atomic<long> allocs(0);
+
+long bench_allocs()
+{
+	return allocs.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+	allocs.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
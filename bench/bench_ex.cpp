@@ -0,0 +1,749 @@
+#include "bench.h"
+#include "../src/co.h"
+#include "../src/ex.h"
+#include "../src/layout.h"
+#include "../src/loop.h"
+#include "../src/pool.h"
+#include "../src/stb_truetype.h"
+#include "../src/track.h"
+
+#include <stdlib.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <deque>
+#include <thread>
+#include <vector>
+
+#define SUITE "ex"
+
+// Compares the two representations of Ex expressions on chains of 'let'
+// steps: erased, where every node and continuation is a std::function as
+// with Ex<T> alone, and inline, where the chain keeps its static type.
+// Building and running the chain are timed together and running alone, along
+// with the heap blocks each takes.
+
+struct Inc
+{
+	Node<float, Lit<float> > operator()(float x) const { return lit(x + 1.0f); }
+};
+
+struct IncErased
+{
+	Float operator()(float x) const { return lit(x + 1.0f); }
+};
+
+template <int N> struct Chain
+{
+	typedef decltype(let(Chain<N-1>::make(), Inc())) Type;
+	static Type make() { return let(Chain<N-1>::make(), Inc()); }
+};
+
+template <> struct Chain<0>
+{
+	typedef Node<float, Lit<float> > Type;
+	static Type make() { return lit(0.0f); }
+};
+
+static Float erased_chain(int depth)
+{
+	Float e = lit(0.0f);
+	for (int i = 0; i < depth; ++i)
+		e = let(e, IncErased());
+	return e;
+}
+
+struct Store
+{
+	float* out;
+	void operator()(float v) const { *out = v; }
+};
+
+template <typename Build> static void measure(const char* name, int depth, Build build)
+{
+	double start, elapsed;
+	long reps = 0, before;
+	float result = 0;
+
+	before = bench_allocs();
+	start = bench_now();
+	do
+	{
+		build()(Store{&result});
+		if (result != (float)depth) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, name, NULL, (float)depth, elapsed*1e9/((double)reps*depth), "ns/step");
+	bench_report(SUITE, name, NULL, (float)depth, (double)(bench_allocs() - before)/(double)reps, "allocs/eval");
+}
+
+template <int N> static void chain()
+{
+	measure("let_chain_erased", N, [] () { return erased_chain(N); });
+	measure("let_chain_inline", N, [] () { return Chain<N>::make(); });
+
+	// Run only: the chain is built once, as a program would be.
+	Float erased = erased_chain(N);
+	typename Chain<N>::Type inlined = Chain<N>::make();
+	measure("let_run_erased", N, [&] () -> Float const& { return erased; });
+	measure("let_run_inline", N, [&] () -> typename Chain<N>::Type const& { return inlined; });
+}
+
+// A loop of 'steps' bound steps, each producing the next through Ex<long>,
+// run by evalSync. Nested, it would need a stack frame per step.
+static Ex<long> countdown(long n);
+
+struct Step
+{
+	Ex<long> operator()(long i) const { return i == 0 ? Ex<long>(lit(0L)) : countdown(i-1); }
+};
+
+static Ex<long> countdown(long n)
+{
+	return let(lit(n), Step());
+}
+
+static void trampoline(long steps)
+{
+	double start, elapsed;
+	long reps = 0, before;
+
+	before = bench_allocs();
+	start = bench_now();
+	do
+	{
+		if (evalSync(countdown(steps)) != 0) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, "eval_sync_steps", NULL, (float)steps, (double)(steps*reps)/elapsed, "steps/s");
+	bench_report(SUITE, "eval_sync_steps", NULL, (float)steps,
+				 (double)(bench_allocs() - before)/((double)steps*reps), "allocs/step");
+}
+
+// An expression nested to the left 'depth' times, let(let(...), g) or
+// map(map(...), g), built through Ex<long> and run by evalSync. Starting it
+// goes a node deeper at each level before the first step runs, so it is run
+// on a thread with a small stack, which it must not overflow.
+struct NextLong
+{
+	Node<long, Lit<long> > operator()(long i) const { return lit(i+1); }
+};
+
+struct AddOne
+{
+	long operator()(long i) const { return i+1; }
+};
+
+static void left_nested(long depth)
+{
+	Ex<long> let_ = lit(0L), map_ = lit(0L);
+	double start, elapsed;
+	long i, reps;
+
+	for (i = 0; i < depth; ++i)
+	{
+		let_ = let(let_, NextLong());
+		map_ = map(map_, AddOne());
+	}
+
+	reps = 0;
+	start = bench_now();
+	do
+	{
+		if (evalSync(let_) != depth) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, "left_nested_let", NULL, (float)depth, elapsed*1e9/((double)reps*depth), "ns/node");
+
+	reps = 0;
+	start = bench_now();
+	do
+	{
+		if (evalSync(map_) != depth) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, "left_nested_map", NULL, (float)depth, elapsed*1e9/((double)reps*depth), "ns/node");
+}
+
+#ifndef _WIN32
+static void* left_nested_thread(void* depth)
+{
+	left_nested(*(long*)depth);
+	return NULL;
+}
+#endif
+
+static void left_nested_small_stack(long depth)
+{
+#ifndef _WIN32
+	pthread_attr_t attr;
+	pthread_t thread;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, 256*1024);
+	if (pthread_create(&thread, &attr, left_nested_thread, &depth) == 0)
+		pthread_join(thread, NULL);
+	pthread_attr_destroy(&attr);
+#else
+	left_nested(depth);
+#endif
+}
+
+#ifndef _WIN32
+// Time from input arriving on a pipe to the continuation waiting for it
+// running, and the CPU used meanwhile; the loop should sleep until then.
+static void loop_wake()
+{
+	double start, elapsed, ran, latency = 0, written = 0;
+	clock_t cpu;
+	long reps = 0;
+	int fds[2];
+
+	if (pipe(fds) != 0) return;
+	cpu = clock();
+	start = bench_now();
+	do
+	{
+		std::thread writer([&] () {
+			usleep(1000);
+			written = bench_now();
+			if (write(fds[1], "x", 1) != 1) abort();
+		});
+		ran = evalSync(let(readable(fds[0]), [&] () {
+			char c;
+			if (read(fds[0], &c, 1) != 1) abort();
+			return lit(bench_now());
+		}));
+		writer.join();
+		latency += ran - written;
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	cpu = clock() - cpu;
+	close(fds[0]);
+	close(fds[1]);
+
+	bench_report(SUITE, "loop_wake_latency", NULL, 0, latency*1e6/(double)reps, "us");
+	bench_report(SUITE, "loop_wait_cpu", NULL, 0, (double)cpu/CLOCKS_PER_SEC/elapsed, "ratio");
+}
+#endif
+
+// How late a timer fires, on top of the whole millisecond it is rounded to.
+static void loop_timer(int ms)
+{
+	double start, elapsed, late = 0;
+	long reps = 0;
+
+	start = bench_now();
+	do
+	{
+		double t = bench_now();
+		evalSync(after(ms));
+		late += bench_now() - t - ms*1e-3;
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, "loop_timer_late", NULL, (float)ms, late*1e6/(double)reps, "us");
+}
+
+struct Add
+{
+	float x;
+	float operator()(float y) const { return x + y; }
+};
+
+struct AddTo
+{
+	Var<float> b;
+	Node<float, Map<Var<float>, Add> > operator()(float x) const { return map(b, Add{x}); }
+};
+
+struct AddToErased
+{
+	Var<float> b;
+	Float operator()(float x) const { return map(Float(b), Add{x}); }
+};
+
+// Builds a balanced binary tree of 'n' tracked sums over n+1 leaf vars and
+// returns the root. Erased, each sum reads its operands through Ex<float>
+// and so wraps continuations in std::function.
+static Var<float> sum_tree(int n, std::vector<Var<float> >& leaves, std::vector<Float>& getters,
+						   bool erased = false)
+{
+	std::deque<Var<float> > open;
+	int i;
+
+	for (i = 0; i <= n; ++i)
+	{
+		leaves.push_back(Var<float>(1.0f));
+		open.push_back(leaves.back());
+	}
+	while (open.size() > 1)
+	{
+		Var<float> a = open.front();
+		open.pop_front();
+		Var<float> b = open.front();
+		open.pop_front();
+		Var<float> s;
+		if (erased)
+			getters.push_back(let(Float(a), AddToErased{b}));
+		else
+			getters.push_back(let(a, AddTo{b}));
+		evalSync(track(s, getters.back()));
+		open.push_back(s);
+	}
+	return open.front();
+}
+
+// Changing a leaf of a sum tree should recompute only the sums on its path
+// to the root; every getter is also evaluated once, as a runtime without
+// dependencies would have to.
+static void tracking(int n)
+{
+	std::vector<Var<float> > leaves;
+	std::vector<Float> getters;
+	Graph& graph = currentGraph();
+	double start, elapsed;
+	long reps = 0, recomputed;
+	int i;
+
+	start = bench_now();
+	Var<float> root = sum_tree(n, leaves, getters);
+	elapsed = bench_now() - start;
+	bench_report(SUITE, "track_install", NULL, (float)n, elapsed*1e9/n, "ns/value");
+
+	recomputed = graph.recomputed;
+	start = bench_now();
+	do
+	{
+		Var<float>& leaf = leaves[(size_t)(reps*7919 % (n+1))];
+		leaf.set(leaf.peek() + 1.0f);
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	if (root.peek() != (float)(n+1+reps)) abort();
+	bench_report(SUITE, "track_update", NULL, (float)n, elapsed*1e6/(double)reps, "us/change");
+	bench_report(SUITE, "track_update", NULL, (float)n, (double)(graph.recomputed - recomputed)/(double)reps,
+				 "recomputed/change");
+
+	start = bench_now();
+	for (i = 0; i < (int)getters.size(); ++i)
+		evalSync(getters[(size_t)i]);
+	bench_report(SUITE, "track_full_eval", NULL, (float)n, (bench_now() - start)*1e6, "us");
+}
+
+// Frames of a sum tree in which 'changes' random leaves are each set twice,
+// brought up to date after every change (frame_ms 0) or once per frame. CPU
+// time per frame leaves out the wait for the frame boundary.
+static void batching(int n, int changes, int frame_ms)
+{
+	const char* name = frame_ms ? "frame_batched" : "frame_immediate";
+	std::vector<Var<float> > leaves;
+	std::vector<Float> getters;
+	Graph& graph = currentGraph();
+	double start, elapsed;
+	long frames = 0, invalidations, recomputed, renders = 0, seed = 1;
+	clock_t cpu = 0, t;
+	int i;
+
+	Var<float> root = sum_tree(n, leaves, getters);
+	graph.frameMs = frame_ms;
+	graph.render = [&] () { ++renders; };
+	invalidations = graph.invalidations;
+	recomputed = graph.recomputed;
+	start = bench_now();
+	do
+	{
+		t = clock();
+		for (i = 0; i < changes; ++i)
+		{
+			seed = (seed*1103515245 + 12345) & 0x7fffffff;
+			Var<float>& leaf = leaves[(size_t)(seed % (n+1))];
+			leaf.set(leaf.peek() + 1.0f);
+			leaf.set(leaf.peek() + 1.0f);
+		}
+		cpu += clock() - t;
+		while (graph.frameQueued)
+			waitForEvents();
+		t = clock();
+		graph.endFrame();
+		cpu += clock() - t;
+		++frames;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	graph.frameMs = 0;
+	graph.render = nullptr;
+	if (root.peek() != (float)(n+1+2*changes*frames)) abort();
+
+	bench_report(SUITE, name, NULL, (float)n, (double)(graph.invalidations - invalidations)/(double)frames,
+				 "invalidations/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)(graph.recomputed - recomputed)/(double)frames,
+				 "recomputed/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)renders/(double)frames, "renders/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)cpu*1e6/CLOCKS_PER_SEC/(double)frames, "us/frame");
+}
+
+// Frames of an erased sum tree, as in batching, with continuations from the
+// frame arena or from the heap.
+static void arena(int n, int changes, bool use_arena)
+{
+	const char* name = use_arena ? "frame_arena" : "frame_heap";
+	std::vector<Var<float> > leaves;
+	std::vector<Float> getters;
+	Graph& graph = currentGraph();
+	Arena& arena = frameArena();
+	double start, elapsed;
+	long frames = 0, heap = 0, allocs = 0, bytes = 0, before, seed = 1;
+	int i;
+
+	Var<float> root = sum_tree(n, leaves, getters, true);
+	graph.frameMs = 1000000; // frames are ended here
+	graph.useArena = use_arena;
+	start = bench_now();
+	do
+	{
+		for (i = 0; i < changes; ++i)
+		{
+			seed = (seed*1103515245 + 12345) & 0x7fffffff;
+			Var<float>& leaf = leaves[(size_t)(seed % (n+1))];
+			leaf.set(leaf.peek() + 1.0f);
+		}
+		before = bench_allocs();
+		graph.endFrame();
+		heap += bench_allocs() - before;
+		allocs += arena.last.allocs;
+		bytes += arena.last.bytes;
+		++frames;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	graph.frameMs = 0;
+	graph.useArena = true;
+	if (root.peek() != (float)(n+1+changes*frames)) abort();
+
+	bench_report(SUITE, name, NULL, (float)n, elapsed*1e6/(double)frames, "us/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)heap/(double)frames, "heap_allocs/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)allocs/(double)frames, "arena_allocs/frame");
+	bench_report(SUITE, name, NULL, (float)n, (double)bytes/(double)frames, "arena_bytes/frame");
+}
+
+struct Scale
+{
+	float f, d;
+	float operator()(float v) const { return v*f + d; }
+};
+
+struct AddScaled
+{
+	Val<Float> size;
+	Scale s;
+	Node<float, Map<Val<Float>, Scale> > operator()(float pos) const { return map(size, Scale{s.f, pos + s.d}); }
+};
+
+// A two-level UI tree, 'fanout' children under each of 'fanout' children of
+// the root, each child a column of its parent. Laid out by the store, and by
+// evaluating per-node Rect_ getters that read their parent's getters.
+static void layout(int fanout)
+{
+	Layout store(0.0f, 0.0f, 500.0f, 500.0f);
+	std::vector<Rect_> rects;
+	std::vector<int> parents;
+	double start, elapsed;
+	long reps = 0;
+	float sum = 0;
+	int i, j, n;
+
+	rects.push_back(Rect_{lit(0.0f), lit(0.0f), lit(500.0f), lit(500.0f)});
+	parents.push_back(0);
+	for (i = 0; i < fanout; ++i)
+		parents.push_back(0);
+	for (i = 0; i < fanout; ++i)
+		for (j = 0; j < fanout; ++j)
+			parents.push_back(1+i);
+	n = (int)parents.size();
+	for (i = 1; i < n; ++i)
+	{
+		int p = parents[(size_t)i];
+		int k = (i-1) % fanout;
+		float f = 1.0f/fanout;
+		store.add(p, fraction(f*k), offset(2.0f), fraction(f), offset(-4.0f));
+		Rect_ const& pr = rects[(size_t)p];
+		rects.push_back(Rect_{let(pr.l, AddScaled{pr.w, Scale{f*k, 0.0f}}), map(pr.t, Scale{1.0f, 2.0f}),
+							  map(pr.w, Scale{f, 0.0f}), map(pr.h, Scale{1.0f, -4.0f})});
+	}
+
+	start = bench_now();
+	do
+	{
+		store.solve();
+		sum += store.w(n-1);
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, "layout_soa", NULL, (float)n, elapsed*1e9/((double)reps*n), "ns/node");
+
+	start = bench_now();
+	reps = 0;
+	do
+	{
+		for (i = 0; i < n; ++i)
+		{
+			Rect_ const& r = rects[(size_t)i];
+			sum += evalSync(r.l) + evalSync(r.t) + evalSync(r.w) + evalSync(r.h);
+		}
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, "layout_val", NULL, (float)n, elapsed*1e9/((double)reps*n), "ns/node");
+
+	// Both must agree on the last node.
+	if (evalSync(rects[(size_t)n-1].l) != store.l(n-1) || evalSync(rects[(size_t)n-1].w) != store.w(n-1))
+		abort();
+	if (sum == 0) abort();
+}
+
+// The inner width of a bordered 500x500 rect, from literals: folded by the
+// compiler, erased, where each operand is an Ex<float> run when evaluated,
+// and read from a rect getter and a tracked var.
+template <typename E> static void fold(const char* name, E const& e)
+{
+	double start, elapsed;
+	long reps = 0, before;
+	float result = 0;
+
+	before = bench_allocs();
+	start = bench_now();
+	do
+	{
+		e(Store{&result});
+		if (result != 492.0f) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, name, NULL, 0, elapsed*1e9/(double)reps, "ns/eval");
+	bench_report(SUITE, name, NULL, 0, (double)(bench_allocs() - before)/(double)reps, "allocs/eval");
+}
+
+static void folding()
+{
+	constexpr auto folded = fixedRect(lit(0.0f), lit(0.0f), lit(500.0f) - lit(2.0f)*lit(4.0f), lit(500.0f));
+	static_assert(constValue(folded).w == 492.0f, "not folded");
+
+	fold("fold_const", lit(constValue(folded).w));
+	fold("fold_erased", Float(Float(lit(500.0f)) - Float(lit(2.0f))*Float(lit(4.0f))));
+
+	// The same from a rect's getter and a var, as UI code writes it.
+	Var<float> border(4.0f);
+	Rect_ rect = {lit(0.0f), lit(0.0f), lit(500.0f), lit(500.0f)};
+	fold("fold_tracked", rect.w - lit(2.0f)*border);
+}
+
+#ifdef EX_COROUTINES
+// The same loops of n steps written as coroutines and in CPS, where each
+// step awaits a value that is ready, gives control back to evalSync and is
+// resumed from its queue, or calls a child task.
+
+struct Yield
+{
+	template <typename K> void operator()(K const& k) const { trampoline().queue.push_back(F<void ()>(k)); }
+};
+
+static const Node<void, Yield> yield_ = {};
+
+static Task<long> co_ready(long n)
+{
+	long sum = 0;
+	for (long i = 0; i < n; ++i)
+		sum += co_await lit(1L);
+	co_return sum;
+}
+
+static Task<long> co_yield_(long n)
+{
+	long i;
+	for (i = 0; i < n; ++i)
+		co_await yield_;
+	co_return i;
+}
+
+static Task<long> co_one()
+{
+	co_return 1L;
+}
+
+static Task<long> co_calls(long n)
+{
+	long sum = 0;
+	for (long i = 0; i < n; ++i)
+		sum += co_await co_one();
+	co_return sum;
+}
+
+static Ex<long> cps_ready(long n, long sum);
+static Ex<long> cps_yield(long n, long i);
+
+struct ReadyStep
+{
+	long n, sum;
+	Ex<long> operator()(long v) const { return cps_ready(n-1, sum+v); }
+};
+
+static Ex<long> cps_ready(long n, long sum)
+{
+	return n == 0 ? Ex<long>(lit(sum)) : Ex<long>(let(lit(1L), ReadyStep{n, sum}));
+}
+
+struct YieldStep
+{
+	long n, i;
+	Ex<long> operator()() const { return cps_yield(n, i+1); }
+};
+
+static Ex<long> cps_yield(long n, long i)
+{
+	return i == n ? Ex<long>(lit(i)) : Ex<long>(let(yield_, YieldStep{n, i}));
+}
+
+template <typename Build> static void steps(const char* name, long n, Build build)
+{
+	double start, elapsed;
+	long reps = 0, before;
+
+	before = bench_allocs();
+	start = bench_now();
+	do
+	{
+		if (evalSync(build()) != n) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, name, NULL, (float)n, elapsed*1e9/((double)n*reps), "ns/step");
+	bench_report(SUITE, name, NULL, (float)n, (double)(bench_allocs() - before)/((double)n*reps), "allocs/step");
+}
+
+static void coroutines(long n)
+{
+	steps("co_ready", n, [=] () { return co_ready(n); });
+	steps("cps_ready", n, [=] () { return cps_ready(n, 0); });
+	steps("co_yield", n, [=] () { return co_yield_(n); });
+	steps("cps_yield", n, [=] () { return cps_yield(n, 0); });
+	steps("co_call", n, [=] () { return co_calls(n); });
+}
+#endif
+
+// A wide UI tree: 'leaves' labels whose widths are measured from the font's
+// metrics, a few hundred glyph advances and kerning pairs each, then summed.
+// Measured one after another by evalSync, and with all() on pools of 1 to 8
+// threads.
+struct Measure
+{
+	const stbtt_fontinfo* info;
+	const char* text;
+	int passes;
+	float operator()(float scale) const
+	{
+		int w = 0, adv, lsb, p;
+		const char* c;
+		for (p = 0; p < passes; ++p)
+		{
+			for (c = text; *c; ++c)
+			{
+				stbtt_GetCodepointHMetrics(info, *c, &adv, &lsb);
+				w += adv;
+				if (c[1]) w += stbtt_GetCodepointKernAdvance(info, *c, c[1]);
+			}
+		}
+		return (float)w*scale;
+	}
+};
+
+static void wide_tree(int leaves)
+{
+	static const int threads[] = { 1, 2, 4, 8 };
+	const struct bench_font* f = &bench_fonts[0];
+	stbtt_fontinfo info;
+	std::vector<Float> labels;
+	double start, elapsed, seq;
+	long reps = 0;
+	float sum = 0, expect = 0;
+	int i;
+
+	if (!stbtt_InitFont(&info, f->data, 0)) return;
+	for (i = 0; i < leaves; ++i)
+		labels.push_back(map(lit(stbtt_ScaleForPixelHeight(&info, (float)(12 + i % 4*4))), Measure{&info, f->text, 8}));
+	for (i = 0; i < leaves; ++i)
+		expect += evalSync(labels[(size_t)i]);
+
+	start = bench_now();
+	do
+	{
+		sum = 0;
+		for (i = 0; i < leaves; ++i)
+			sum += evalSync(labels[(size_t)i]);
+		if (sum != expect) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	seq = elapsed*1e3/(double)reps;
+	bench_report(SUITE, "measure_seq", NULL, (float)leaves, seq, "ms/tree");
+
+	for (i = 0; i < (int)(sizeof(threads)/sizeof(threads[0])); ++i)
+	{
+		Pool pool(threads[i]);
+		char name[32];
+		setWorkPool(&pool);
+		snprintf(name, sizeof(name), "measure_all_%d", threads[i]);
+		start = bench_now();
+		reps = 0;
+		do
+		{
+			std::vector<float> widths = evalSync(all(labels));
+			sum = 0;
+			for (float w: widths)
+				sum += w;
+			if (sum != expect) abort();
+			++reps;
+			elapsed = bench_now() - start;
+		} while (elapsed < bench_mintime);
+		setWorkPool(NULL);
+		bench_report(SUITE, name, NULL, (float)leaves, elapsed*1e3/(double)reps, "ms/tree");
+		bench_report(SUITE, name, NULL, (float)leaves, seq/(elapsed*1e3/(double)reps), "speedup");
+		bench_report(SUITE, name, NULL, (float)leaves, (double)pool.steals/(double)reps, "steals/tree");
+	}
+}
+
+void bench_ex()
+{
+	chain<4>();
+	chain<16>();
+	chain<64>();
+	trampoline(1000000);
+	trampoline(4000000);
+	left_nested_small_stack(2000);
+#ifndef _WIN32
+	loop_wake();
+#endif
+	loop_timer(1);
+	loop_timer(10);
+	tracking(100000);
+	batching(10000, 64, 0);
+	batching(10000, 64, 16);
+	arena(10000, 64, false);
+	arena(10000, 64, true);
+	layout(32);
+	layout(100);
+	folding();
+	wide_tree(256);
+#ifdef EX_COROUTINES
+	coroutines(100000);
+#endif
+}
@@ -0,0 +1,479 @@
+#include "bench.h"
+#include "glstub.h"
+#include "../src/fontstash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <thread>
+
+#define SUITE "fontstash"
+#define CACHE_SIZE 1024
+#define ATLAS_SIZE 512
+
+static const float sizes[] = { 12.0f, 24.0f, 48.0f };
+static const int nsizes = sizeof(sizes)/sizeof(sizes[0]);
+static const float large_sizes[] = { 256.0f, 512.0f };
+static const int nlarge = sizeof(large_sizes)/sizeof(large_sizes[0]);
+
+static int count_codepoints(const char* s)
+{
+	int n = 0;
+	for (; *s; ++s)
+		if ((*s & 0xc0) != 0x80) ++n;
+	return n;
+}
+
+static struct sth_stash* make_stash(const struct bench_font* f, int w, int h)
+{
+	struct sth_stash* stash = sth_create(w, h);
+	if (stash && !sth_add_font(stash, 0, f->path))
+	{
+		sth_delete(stash);
+		stash = NULL;
+	}
+	return stash;
+}
+
+// Every glyph in 'text' misses the cache: a fresh stash is made for each
+// repetition, and only the draw/dim call itself is timed.
+static void cold(const struct bench_font* f, float size, const char* text, int nglyphs)
+{
+	double draw = 0, dim = 0, t;
+	int reps = 0;
+	float minx, miny, maxx, maxy;
+
+	while (draw + dim < bench_mintime)
+	{
+		struct sth_stash* stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		t = bench_now();
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		draw += bench_now() - t;
+		sth_delete(stash);
+
+		stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		t = bench_now();
+		sth_dim_text(stash, 0, size, text, &minx, &miny, &maxx, &maxy);
+		dim += bench_now() - t;
+		sth_delete(stash);
+		++reps;
+	}
+
+	bench_report(SUITE, "draw_text_cold", f->name, size, draw*1e9/((double)reps*nglyphs), "ns/glyph");
+	bench_report(SUITE, "dim_text_cold", f->name, size, dim*1e9/((double)reps*nglyphs), "ns/glyph");
+}
+
+// Every glyph in 'text' is rasterized by one sth_prewarm call into a fresh
+// stash, spread over 'threads' threads. Compare with dim_text_cold.
+static void prewarm(const struct bench_font* f, float size, const char* text, int nglyphs, int threads)
+{
+	static const char* names[] = { "prewarm", "prewarm_t2", "prewarm_t3", "prewarm_t4" };
+	double t, elapsed = 0;
+	int reps = 0;
+
+	while (elapsed < bench_mintime)
+	{
+		struct sth_stash* stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		sth_set_threads(stash, threads);
+		t = bench_now();
+		sth_prewarm(stash, 0, size, text);
+		elapsed += bench_now() - t;
+		sth_delete(stash);
+		++reps;
+	}
+
+	bench_report(SUITE, names[threads-1], f->name, size, elapsed*1e9/((double)reps*nglyphs), "ns/glyph");
+}
+
+// Returns the per-glyph cost of drawing/measuring 'text' once all of its
+// glyphs are cached.
+static void warm(const struct bench_font* f, float size, const char* text, int nglyphs,
+				 double* draw_ns, double* dim_ns)
+{
+	double start, elapsed;
+	long reps;
+	float minx, miny, maxx, maxy;
+	struct sth_stash* stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+
+	sth_dim_text(stash, 0, size, text, &minx, &miny, &maxx, &maxy);
+
+	reps = 0;
+	start = bench_now();
+	do
+	{
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime/2);
+	*draw_ns = elapsed*1e9/((double)reps*nglyphs);
+
+	reps = 0;
+	start = bench_now();
+	do
+	{
+		sth_dim_text(stash, 0, size, text, &minx, &miny, &maxx, &maxy);
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime/2);
+	*dim_ns = elapsed*1e9/((double)reps*nglyphs);
+
+	sth_delete(stash);
+}
+
+// Cost of a get_glyph miss, taken as the difference between measuring a
+// string of distinct uncached glyphs and measuring it again once cached.
+static void miss(const struct bench_font* f, float size, const char* text, int nglyphs)
+{
+	double cold_ns, draw_ns = 0, dim_ns = 0, t, elapsed = 0;
+	int reps = 0;
+	float minx, miny, maxx, maxy;
+
+	while (elapsed < bench_mintime)
+	{
+		struct sth_stash* stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		t = bench_now();
+		sth_dim_text(stash, 0, size, text, &minx, &miny, &maxx, &maxy);
+		elapsed += bench_now() - t;
+		sth_delete(stash);
+		++reps;
+	}
+	cold_ns = elapsed*1e9/((double)reps*nglyphs);
+	warm(f, size, text, nglyphs, &draw_ns, &dim_ns);
+	bench_report(SUITE, "get_glyph_miss", f->name, size, cold_ns - dim_ns, "ns/glyph");
+}
+
+// Renders every glyph of the range at several sizes into one stash, so
+// each glyph is rasterized once per size. With the outline cache the glyph
+// is parsed only for the first size; 'cache' is its budget in bytes.
+static void size_sweep(const struct bench_font* f, const char* text, int cache)
+{
+	static const float sweep_sizes[] = { 12.0f, 14.0f, 16.0f, 18.0f, 20.0f, 24.0f, 28.0f, 32.0f };
+	const int nsweep = (int)(sizeof(sweep_sizes)/sizeof(sweep_sizes[0]));
+	double t, elapsed = 0;
+	int i, reps = 0;
+	float minx, miny, maxx, maxy;
+
+	while (elapsed < bench_mintime)
+	{
+		struct sth_stash* stash = make_stash(f, CACHE_SIZE*2, CACHE_SIZE*2);
+		if (!stash) return;
+		sth_set_outline_cache(stash, cache);
+		t = bench_now();
+		for (i = 0; i < nsweep; ++i)
+			sth_dim_text(stash, 0, sweep_sizes[i], text, &minx, &miny, &maxx, &maxy);
+		elapsed += bench_now() - t;
+		sth_delete(stash);
+		++reps;
+	}
+
+	bench_report(SUITE, cache ? "size_sweep" : "size_sweep_nocache", f->name, 0,
+				 elapsed*1e9/((double)reps*nsweep*f->count), "ns/glyph");
+}
+
+// Feeds glyphs of increasing size into a small atlas until it reports
+// full, and records how much of the texture ended up holding glyph pixels.
+static void atlas_fill(const struct bench_font* f)
+{
+	static const float fill_sizes[] = { 12.0f, 14.0f, 16.0f, 18.0f, 24.0f, 32.0f, 48.0f, 64.0f };
+	char s[8];
+	int i, j, placed = 0, full = 0;
+	long uploads;
+	float minx, miny, maxx, maxy;
+	const struct glstub_stats* st;
+	struct sth_stash* stash = make_stash(f, ATLAS_SIZE, ATLAS_SIZE);
+	if (!stash) return;
+
+	glstub_reset();
+	st = glstub_get();
+	for (i = 0; i < (int)(sizeof(fill_sizes)/sizeof(fill_sizes[0])) && !full; ++i)
+	{
+		for (j = 0; j < f->count; ++j)
+		{
+			s[bench_utf8(s, f->first+(unsigned)j)] = 0;
+			uploads = st->uploads;
+			sth_dim_text(stash, 0, fill_sizes[i], s, &minx, &miny, &maxx, &maxy);
+			if (st->uploads == uploads)
+			{
+				full = 1;
+				break;
+			}
+			++placed;
+		}
+	}
+
+	bench_report(SUITE, "atlas_glyphs", f->name, 0, placed, full ? "glyphs(full)" : "glyphs");
+	bench_report(SUITE, "atlas_texel_fill", f->name, 0,
+				 (double)st->texels/(ATLAS_SIZE*ATLAS_SIZE), "ratio");
+	bench_report(SUITE, "atlas_row_extent", f->name, 0, (double)st->maxy/ATLAS_SIZE, "ratio");
+	if (st->maxy > 0)
+		bench_report(SUITE, "atlas_used_fill", f->name, 0,
+					 (double)st->texels/((double)st->maxy*ATLAS_SIZE), "ratio");
+
+	sth_delete(stash);
+}
+
+// Resident file-backed memory of the process in KB, or -1 where unknown.
+static double resident_file_kb()
+{
+#ifdef __linux__
+	long size = 0, resident = 0, shared = 0;
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (!fp) return -1;
+	if (fscanf(fp, "%ld %ld %ld", &size, &resident, &shared) != 3) shared = -1;
+	fclose(fp);
+	return shared < 0 ? -1 : shared*(sysconf(_SC_PAGESIZE)/1024.0);
+#else
+	return -1;
+#endif
+}
+
+// Time for sth_add_font, which should not depend on the size of the file,
+// and for adding the same file to a second slot, which shares it; the same
+// for sth_add_font_async; and how much of the file is resident
+// once 'text' has been measured.
+static void load(const struct bench_font* f, const char* text)
+{
+	double t, elapsed = 0, ready, before;
+	long reps = 0;
+	float minx, miny, maxx, maxy;
+	struct sth_stash* stash = sth_create(CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+
+	do
+	{
+		t = bench_now();
+		if (!sth_add_font(stash, 0, f->path)) break;
+		elapsed += bench_now() - t;
+		++reps;
+	} while (elapsed < bench_mintime);
+	if (reps == 0)
+	{
+		sth_delete(stash);
+		return;
+	}
+	bench_report(SUITE, "add_font", f->name, 0, elapsed*1e6/(double)reps, "us");
+
+	// Another slot on the same file, which slot 0 keeps open.
+	elapsed = 0;
+	reps = 0;
+	do
+	{
+		t = bench_now();
+		if (!sth_add_font(stash, 1, f->path)) break;
+		elapsed += bench_now() - t;
+		++reps;
+	} while (elapsed < bench_mintime);
+	sth_delete(stash);
+	if (reps == 0) return;
+	bench_report(SUITE, "add_font_shared", f->name, 0, elapsed*1e6/(double)reps, "us");
+
+	// The async call itself, and the time until the font can be drawn.
+	stash = sth_create(CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+	elapsed = ready = 0;
+	reps = 0;
+	do
+	{
+		t = bench_now();
+		if (!sth_add_font_async(stash, 0, f->path)) break;
+		elapsed += bench_now() - t;
+		while (sth_font_ready(stash, 0) == 0)
+			std::this_thread::yield();
+		ready += bench_now() - t;
+		++reps;
+	} while (ready < bench_mintime);
+	sth_delete(stash);
+	if (reps == 0) return;
+	bench_report(SUITE, "add_font_async", f->name, 0, elapsed*1e6/(double)reps, "us");
+	bench_report(SUITE, "add_font_async_ready", f->name, 0, ready*1e6/(double)reps, "us");
+
+	stash = sth_create(CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+	before = resident_file_kb();
+	if (before >= 0 && sth_add_font(stash, 0, f->path))
+	{
+		sth_dim_text(stash, 0, sizes[0], text, &minx, &miny, &maxx, &maxy);
+		bench_report(SUITE, "font_resident", f->name, 0, resident_file_kb() - before, "KB");
+		bench_report(SUITE, "font_file", f->name, 0, f->datasize/1024.0, "KB");
+	}
+	sth_delete(stash);
+}
+
+// Draws 'text' at a title size, as meshes when 'vector' is set and from the
+// texture otherwise: the first draw, which makes every glyph, later draws,
+// and the texels the first draw put in the texture.
+static void large(const struct bench_font* f, float size, const char* text, int nglyphs, int vector)
+{
+	double t, first = 0, elapsed;
+	long reps = 0, texels = 0;
+	struct sth_stash* stash;
+
+	while (first < bench_mintime)
+	{
+		stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		sth_set_vector_size(stash, vector ? size : 0);
+		glstub_reset();
+		t = bench_now();
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		first += bench_now() - t;
+		texels = glstub_get()->texels;
+		sth_delete(stash);
+		++reps;
+	}
+	bench_report(SUITE, vector ? "draw_large_vector_cold" : "draw_large_bitmap_cold", f->name, size,
+				 first*1e9/((double)reps*nglyphs), "ns/glyph");
+	bench_report(SUITE, vector ? "large_vector_texels" : "large_bitmap_texels", f->name, size,
+				 (double)texels/nglyphs, "texels/glyph");
+
+	stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+	sth_set_vector_size(stash, vector ? size : 0);
+	sth_begin_draw(stash);
+	sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+	sth_end_draw(stash);
+	reps = 0;
+	t = bench_now();
+	do
+	{
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		++reps;
+		elapsed = bench_now() - t;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, vector ? "draw_large_vector_warm" : "draw_large_bitmap_warm", f->name, size,
+				 elapsed*1e9/((double)reps*nglyphs), "ns/glyph");
+	sth_delete(stash);
+}
+
+// Draws a string mixing the first font's script with the last one's from
+// the first font, with the last font as its fallback, once every glyph is
+// cached: the cost of finding each glyph's font through the memo.
+static void mixed(const struct bench_font* latin, const struct bench_font* cjk, float size)
+{
+	static const char* text = "Hello 日本語のテキスト and some more Latin text";
+	double start, elapsed;
+	long reps = 0;
+	int nglyphs = count_codepoints(text);
+	struct sth_stash* stash = make_stash(latin, CACHE_SIZE, CACHE_SIZE);
+	if (!stash) return;
+	if (!sth_add_font(stash, 1, cjk->path) || !sth_add_fallback(stash, 0, 1))
+	{
+		sth_delete(stash);
+		return;
+	}
+
+	sth_begin_draw(stash);
+	sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+	sth_end_draw(stash);
+	start = bench_now();
+	do
+	{
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	bench_report(SUITE, "draw_text_fallback", latin->name, size, elapsed*1e9/((double)reps*nglyphs), "ns/glyph");
+
+	sth_delete(stash);
+}
+
+// Startup to first frame for text the baked atlas covers: making a stash,
+// adding the font and drawing once, with and without adopting the atlas.
+static void first_frame(const struct bench_font* f, float size, const char* text)
+{
+	double cold = 0, baked = 0, t;
+	int reps = 0;
+
+	while (cold + baked < bench_mintime)
+	{
+		struct sth_stash* stash;
+		t = bench_now();
+		stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		cold += bench_now() - t;
+		sth_delete(stash);
+
+		t = bench_now();
+		stash = make_stash(f, CACHE_SIZE, CACHE_SIZE);
+		if (!stash) return;
+		if (!sth_add_baked(stash, bench_baked, bench_bakedsize))
+		{
+			sth_delete(stash);
+			return;
+		}
+		sth_begin_draw(stash);
+		sth_draw_text(stash, 0, size, 0xffffffff, 0, 0, text, NULL);
+		sth_end_draw(stash);
+		baked += bench_now() - t;
+		sth_delete(stash);
+		++reps;
+	}
+
+	bench_report(SUITE, "first_frame_cold", f->name, size, cold*1e6/(double)reps, "us");
+	bench_report(SUITE, "first_frame_baked", f->name, size, baked*1e6/(double)reps, "us");
+}
+
+void bench_fontstash()
+{
+	int i, j;
+	for (i = 0; i < bench_nfonts; ++i)
+	{
+		const struct bench_font* f = &bench_fonts[i];
+		char* range = bench_range_text(f->first, f->count);
+		int ntext = count_codepoints(f->text);
+		if (!range) return;
+
+		load(f, f->text);
+		for (j = 0; j < nsizes; ++j)
+		{
+			double draw_ns = 0, dim_ns = 0;
+			cold(f, sizes[j], range, f->count);
+			prewarm(f, sizes[j], range, f->count, 1);
+			prewarm(f, sizes[j], range, f->count, 4);
+			warm(f, sizes[j], f->text, ntext, &draw_ns, &dim_ns);
+			bench_report(SUITE, "draw_text_warm", f->name, sizes[j], draw_ns, "ns/glyph");
+			bench_report(SUITE, "dim_text_warm", f->name, sizes[j], dim_ns, "ns/glyph");
+			miss(f, sizes[j], range, f->count);
+		}
+		for (j = 0; j < nlarge; ++j)
+		{
+			large(f, large_sizes[j], f->text, ntext, 0);
+			large(f, large_sizes[j], f->text, ntext, 1);
+		}
+		size_sweep(f, range, 0);
+		size_sweep(f, range, 256*1024);
+		atlas_fill(f);
+
+		free(range);
+	}
+
+	for (j = 0; j < nsizes; ++j)
+		mixed(&bench_fonts[0], &bench_fonts[bench_nfonts-1], sizes[j]);
+
+	if (bench_baked)
+	{
+		first_frame(&bench_fonts[0], 12.0f, bench_fonts[0].text);
+		first_frame(&bench_fonts[0], 24.0f, bench_fonts[0].text);
+	}
+}
@@ -0,0 +1,140 @@
+#include "bench.h"
+#include "../src/co.h"
+#include "../src/pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <vector>
+
+#define SUITE "join"
+
+#ifdef EX_COROUTINES
+// Joins on the work pool whose branches are tasks: a task per row awaits
+// all() over a task per cell, then both() over two more. The branches run on
+// workers, so task copies are dropped there and the awaiting task may be
+// resumed there while it is still suspending. 'make bench-tsan' runs this
+// suite under ThreadSanitizer.
+static Task<long> cell(long i)
+{
+	co_return i*i;
+}
+
+static Task<long> row(long i, long cells)
+{
+	std::vector<Task<long> > tasks;
+	long j, sum = 0;
+	for (j = 0; j < cells; ++j)
+		tasks.push_back(cell(i*cells + j));
+	std::vector<long> widths = co_await all(tasks);
+	for (j = 0; j < cells; ++j)
+		sum += widths[(size_t)j];
+	std::pair<long, long> ends = co_await both(cell(i), cell(i+1));
+	co_return sum + ends.first + ends.second;
+}
+
+static Task<long> table(long rows, long cells)
+{
+	std::vector<Task<long> > tasks;
+	long i, sum = 0;
+	for (i = 0; i < rows; ++i)
+		tasks.push_back(row(i, cells));
+	std::vector<long> heights = co_await all(tasks);
+	for (i = 0; i < rows; ++i)
+		sum += heights[(size_t)i];
+	co_return sum;
+}
+
+static void join_tasks(int threads, long rows, long cells)
+{
+	Pool pool(threads);
+	double start, elapsed;
+	long i, reps = 0, expect = 0;
+	char name[32];
+
+	for (i = 0; i < rows*cells; ++i)
+		expect += i*i;
+	for (i = 0; i < rows; ++i)
+		expect += i*i + (i+1)*(i+1);
+
+	setWorkPool(&pool);
+	start = bench_now();
+	do
+	{
+		if (evalSync(table(rows, cells)) != expect) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	setWorkPool(NULL);
+
+	snprintf(name, sizeof(name), "join_tasks_%d", threads);
+	bench_report(SUITE, name, NULL, (float)(rows*cells), elapsed*1e6/(double)reps, "us/table");
+	bench_report(SUITE, name, NULL, (float)(rows*cells), (double)pool.steals/(double)reps, "steals/table");
+}
+
+// The same joins over branches that pass on nothing: each adds to a counter,
+// and the table checks the total once every join has finished.
+static Void add(std::atomic<long>* sum, long v)
+{
+	return Void([sum, v] (Void::Cont k) { sum->fetch_add(v, std::memory_order_relaxed); k(); });
+}
+
+static Task<void> row_void(std::atomic<long>* sum, long i, long cells)
+{
+	std::vector<Void> adds;
+	long j;
+	for (j = 0; j < cells; ++j)
+		adds.push_back(add(sum, (i*cells + j)*(i*cells + j)));
+	co_await all(adds);
+	co_await both(add(sum, i*i), add(sum, (i+1)*(i+1)));
+}
+
+static Task<void> table_void(std::atomic<long>* sum, long rows, long cells)
+{
+	std::vector<Task<void> > tasks;
+	long i;
+	for (i = 0; i < rows; ++i)
+		tasks.push_back(row_void(sum, i, cells));
+	co_await all(tasks);
+}
+
+static void join_void(int threads, long rows, long cells)
+{
+	Pool pool(threads);
+	std::atomic<long> sum(0);
+	double start, elapsed;
+	long i, reps = 0, expect = 0;
+	char name[32];
+
+	for (i = 0; i < rows*cells; ++i)
+		expect += i*i;
+	for (i = 0; i < rows; ++i)
+		expect += i*i + (i+1)*(i+1);
+
+	setWorkPool(&pool);
+	start = bench_now();
+	do
+	{
+		sum.store(0);
+		evalSync(table_void(&sum, rows, cells));
+		if (sum.load() != expect) abort();
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+	setWorkPool(NULL);
+
+	snprintf(name, sizeof(name), "join_void_%d", threads);
+	bench_report(SUITE, name, NULL, (float)(rows*cells), elapsed*1e6/(double)reps, "us/table");
+}
+#endif
+
+void bench_join()
+{
+#ifdef EX_COROUTINES
+	join_tasks(1, 64, 4);
+	join_tasks(4, 64, 4);
+	join_void(1, 64, 4);
+	join_void(4, 64, 4);
+#endif
+}
@@ -0,0 +1,181 @@
+#include "bench.h"
+#include "../src/stb_truetype.h"
+
+#include <stdlib.h>
+
+#define SUITE "raster"
+#define FLATNESS 0.35f
+#define TILE_SIZE 64
+
+// Compares the supersampling rasterizer (version 1) with the exact-area one
+// (version 2) on the same outlines: time per glyph for each, and how far
+// their 8-bit output differs. Large sizes are also rendered in tiles, with
+// empty tiles skipped as fontstash does.
+
+static const float sizes[] = { 12.0f, 24.0f, 48.0f, 96.0f, 192.0f, 384.0f };
+static const int nsizes = sizeof(sizes)/sizeof(sizes[0]);
+
+struct raster_glyph
+{
+	stbtt_vertex* verts;
+	int nverts;
+	int x0, y0, w, h;
+};
+
+static double time_version(const struct raster_glyph* glyphs, int count, float scale,
+						   unsigned char* bmp, int version)
+{
+	double start, elapsed;
+	long reps = 0;
+	int i;
+	stbtt__bitmap gbm;
+
+	start = bench_now();
+	do
+	{
+		for (i = 0; i < count; ++i)
+		{
+			const struct raster_glyph* g = &glyphs[i];
+			if (!g->w || !g->h) continue;
+			gbm.pixels = bmp;
+			gbm.w = g->w;
+			gbm.h = g->h;
+			gbm.stride = g->w;
+			stbtt_RasterizeWithVersion(&gbm, FLATNESS, g->verts, g->nverts, scale, scale, g->x0, g->y0, 1, version, NULL);
+		}
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	return elapsed*1e9/((double)reps*count);
+}
+
+static void count_tile(void* ctx, int /*x*/, int /*y*/, int w, int h, const unsigned char* /*pixels*/, int /*stride*/)
+{
+	*(long*)ctx += (long)w*h;
+}
+
+static void tiled(const struct bench_font* f, const struct raster_glyph* glyphs, int count, float size, float scale)
+{
+	double start, elapsed;
+	long reps = 0, texels = 0, pixels = 0;
+	int i;
+
+	for (i = 0; i < count; ++i)
+	{
+		const struct raster_glyph* g = &glyphs[i];
+		stbtt_RasterizeTiled(g->w, g->h, TILE_SIZE, 1, FLATNESS, g->verts, g->nverts, scale, scale, g->x0, g->y0, 1,
+							 count_tile, &texels, NULL);
+		pixels += (long)g->w*g->h;
+	}
+
+	start = bench_now();
+	do
+	{
+		long ignored = 0;
+		for (i = 0; i < count; ++i)
+		{
+			const struct raster_glyph* g = &glyphs[i];
+			stbtt_RasterizeTiled(g->w, g->h, TILE_SIZE, 1, FLATNESS, g->verts, g->nverts, scale, scale, g->x0, g->y0, 1,
+								 count_tile, &ignored, NULL);
+		}
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, "rasterize_tiled", f->name, size, elapsed*1e9/((double)reps*count), "ns/glyph");
+	if (pixels > 0)
+		bench_report(SUITE, "tiled_texels", f->name, size, (double)texels/(double)pixels, "ratio");
+}
+
+static void compare(const struct bench_font* f, const struct raster_glyph* glyphs, int count, float size, float scale,
+					unsigned char* a, unsigned char* b)
+{
+	double total = 0;
+	long pixels = 0, differing = 0;
+	int i, k, maxdiff = 0;
+	stbtt__bitmap gbm;
+
+	for (i = 0; i < count; ++i)
+	{
+		const struct raster_glyph* g = &glyphs[i];
+		if (!g->w || !g->h) continue;
+		gbm.w = g->w;
+		gbm.h = g->h;
+		gbm.stride = g->w;
+		gbm.pixels = a;
+		stbtt_RasterizeWithVersion(&gbm, FLATNESS, g->verts, g->nverts, scale, scale, g->x0, g->y0, 1, 1, NULL);
+		gbm.pixels = b;
+		stbtt_RasterizeWithVersion(&gbm, FLATNESS, g->verts, g->nverts, scale, scale, g->x0, g->y0, 1, 2, NULL);
+		for (k = 0; k < g->w*g->h; ++k)
+		{
+			int d = abs((int)a[k] - (int)b[k]);
+			total += d;
+			if (d) ++differing;
+			if (d > maxdiff) maxdiff = d;
+		}
+		pixels += (long)g->w*g->h;
+	}
+
+	if (pixels == 0) return;
+	bench_report(SUITE, "diff_mean", f->name, size, total/(double)pixels, "levels");
+	bench_report(SUITE, "diff_max", f->name, size, maxdiff, "levels");
+	bench_report(SUITE, "diff_pixels", f->name, size, (double)differing/(double)pixels, "ratio");
+}
+
+void bench_raster()
+{
+	int i, j, k;
+	for (i = 0; i < bench_nfonts; ++i)
+	{
+		const struct bench_font* f = &bench_fonts[i];
+		stbtt_fontinfo info;
+		struct raster_glyph* glyphs;
+
+		info.userdata = NULL;
+		if (!stbtt_InitFont(&info, f->data, 0)) continue;
+		glyphs = (struct raster_glyph*)malloc(sizeof(struct raster_glyph)*(size_t)f->count);
+		if (!glyphs) return;
+		for (k = 0; k < f->count; ++k)
+		{
+			int g = stbtt_FindGlyphIndex(&info, (int)(f->first+(unsigned)k));
+			glyphs[k].nverts = stbtt_GetGlyphShape(&info, g, &glyphs[k].verts);
+		}
+
+		for (j = 0; j < nsizes; ++j)
+		{
+			float scale = stbtt_ScaleForPixelHeight(&info, sizes[j]);
+			int maxpixels = 1;
+			unsigned char *a, *b;
+			for (k = 0; k < f->count; ++k)
+			{
+				int x0, y0, x1, y1;
+				int g = stbtt_FindGlyphIndex(&info, (int)(f->first+(unsigned)k));
+				stbtt_GetGlyphBitmapBox(&info, g, scale, scale, &x0, &y0, &x1, &y1);
+				glyphs[k].x0 = x0;
+				glyphs[k].y0 = y0;
+				glyphs[k].w = x1-x0;
+				glyphs[k].h = y1-y0;
+				if ((x1-x0)*(y1-y0) > maxpixels) maxpixels = (x1-x0)*(y1-y0);
+			}
+			a = (unsigned char*)malloc((size_t)maxpixels);
+			b = (unsigned char*)malloc((size_t)maxpixels);
+			if (a && b)
+			{
+				bench_report(SUITE, "rasterize_v1", f->name, sizes[j],
+							 time_version(glyphs, f->count, scale, a, 1), "ns/glyph");
+				bench_report(SUITE, "rasterize_v2", f->name, sizes[j],
+							 time_version(glyphs, f->count, scale, a, 2), "ns/glyph");
+				compare(f, glyphs, f->count, sizes[j], scale, a, b);
+				if (sizes[j] > TILE_SIZE)
+					tiled(f, glyphs, f->count, sizes[j], scale);
+			}
+			free(a);
+			free(b);
+		}
+
+		for (k = 0; k < f->count; ++k)
+			stbtt_FreeShape(&info, glyphs[k].verts);
+		free(glyphs);
+	}
+}
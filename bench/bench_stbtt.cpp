@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "../src/stb_truetype.h"
+
+#include <stdlib.h>
+
+#define SUITE "stbtt"
+
+static const float sizes[] = { 12.0f, 24.0f, 48.0f, 96.0f, 192.0f };
+static const int nsizes = sizeof(sizes)/sizeof(sizes[0]);
+
+// Time to decode the outlines of every glyph in the font's range.
+static void glyph_shape(const struct bench_font* f, const stbtt_fontinfo* info, const int* glyphs)
+{
+	double start, elapsed;
+	long reps = 0;
+	int i;
+	stbtt_vertex* verts;
+
+	start = bench_now();
+	do
+	{
+		for (i = 0; i < f->count; ++i)
+		{
+			stbtt_GetGlyphShape(info, glyphs[i], &verts);
+			stbtt_FreeShape(info, verts);
+		}
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, "glyph_shape", f->name, 0, elapsed*1e9/((double)reps*f->count), "ns/glyph");
+}
+
+// Time spent in stbtt_MakeGlyphBitmap per glyph and per output pixel. With
+// an arena, scratch memory comes from it and is reset after every glyph, as
+// fontstash does; the heap blocks it takes once warmed up are reported too.
+static void make_glyph_bitmap(const struct bench_font* f, stbtt_fontinfo* info, const int* glyphs, float size,
+							  stbtt_arena* arena)
+{
+	float scale = stbtt_ScaleForPixelHeight(info, size);
+	double start, elapsed;
+	long reps = 0, pixels = 0;
+	int i, maxw = 0, maxh = 0, heap_allocs = 0;
+	int* box = (int*)malloc(sizeof(int)*2*(size_t)f->count);
+	unsigned char* bmp;
+	if (!box) return;
+
+	for (i = 0; i < f->count; ++i)
+	{
+		int x0, y0, x1, y1;
+		stbtt_GetGlyphBitmapBox(info, glyphs[i], scale, scale, &x0, &y0, &x1, &y1);
+		box[i*2+0] = x1-x0;
+		box[i*2+1] = y1-y0;
+		if (x1-x0 > maxw) maxw = x1-x0;
+		if (y1-y0 > maxh) maxh = y1-y0;
+		pixels += (long)(x1-x0)*(y1-y0);
+	}
+	bmp = (unsigned char*)malloc((size_t)(maxw*maxh)+1);
+	if (!bmp)
+	{
+		free(box);
+		return;
+	}
+
+	info->userdata = arena;
+	if (arena)
+	{
+		for (i = 0; i < f->count; ++i)
+		{
+			stbtt_MakeGlyphBitmap(info, bmp, box[i*2+0], box[i*2+1], box[i*2+0], scale, scale, glyphs[i]);
+			stbtt_ArenaReset(arena);
+		}
+		heap_allocs = arena->heap_allocs;
+	}
+
+	start = bench_now();
+	do
+	{
+		for (i = 0; i < f->count; ++i)
+		{
+			stbtt_MakeGlyphBitmap(info, bmp, box[i*2+0], box[i*2+1], box[i*2+0], scale, scale, glyphs[i]);
+			if (arena) stbtt_ArenaReset(arena);
+		}
+		++reps;
+		elapsed = bench_now() - start;
+	} while (elapsed < bench_mintime);
+
+	bench_report(SUITE, arena ? "make_glyph_bitmap_arena" : "make_glyph_bitmap", f->name, size,
+				 elapsed*1e9/((double)reps*f->count), "ns/glyph");
+	if (pixels > 0 && !arena)
+		bench_report(SUITE, "make_glyph_bitmap_px", f->name, size, elapsed*1e9/((double)reps*pixels), "ns/pixel");
+	if (arena)
+		bench_report(SUITE, "arena_heap_allocs", f->name, size,
+					 (double)(arena->heap_allocs - heap_allocs)/((double)reps*f->count), "allocs/glyph");
+	info->userdata = NULL;
+
+	free(bmp);
+	free(box);
+}
+
+void bench_stbtt()
+{
+	int i, j;
+	for (i = 0; i < bench_nfonts; ++i)
+	{
+		const struct bench_font* f = &bench_fonts[i];
+		stbtt_fontinfo info;
+		int* glyphs;
+
+		info.userdata = NULL;
+		if (!stbtt_InitFont(&info, f->data, 0)) continue;
+		glyphs = (int*)malloc(sizeof(int)*(size_t)f->count);
+		if (!glyphs) return;
+		for (j = 0; j < f->count; ++j)
+			glyphs[j] = stbtt_FindGlyphIndex(&info, (int)(f->first+(unsigned)j));
+
+		glyph_shape(f, &info, glyphs);
+		for (j = 0; j < nsizes; ++j)
+		{
+			stbtt_arena arena;
+			stbtt_ArenaInit(&arena, 0);
+			make_glyph_bitmap(f, &info, glyphs, sizes[j], NULL);
+			make_glyph_bitmap(f, &info, glyphs, sizes[j], &arena);
+			stbtt_ArenaRelease(&arena);
+		}
+
+		free(glyphs);
+	}
+}
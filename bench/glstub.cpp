@@ -0,0 +1,62 @@
+#include "glstub.h"
+
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+static struct glstub_stats stats;
+static GLuint next_tex = 1;
+
+void glstub_reset()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+const struct glstub_stats* glstub_get()
+{
+	return &stats;
+}
+
+void glGenTextures(GLsizei n, GLuint* textures)
+{
+	for (GLsizei i = 0; i < n; ++i)
+		textures[i] = next_tex++;
+}
+
+void glDeleteTextures(GLsizei /*n*/, const GLuint* /*textures*/) {}
+void glBindTexture(GLenum /*target*/, GLuint /*texture*/) {}
+
+void glTexImage2D(GLenum /*target*/, GLint /*level*/, GLint /*internalFormat*/,
+				  GLsizei /*width*/, GLsizei /*height*/, GLint /*border*/,
+				  GLenum /*format*/, GLenum /*type*/, const GLvoid* /*pixels*/) {}
+
+void glTexSubImage2D(GLenum /*target*/, GLint /*level*/, GLint /*xoffset*/, GLint yoffset,
+					 GLsizei width, GLsizei height,
+					 GLenum /*format*/, GLenum /*type*/, const GLvoid* /*pixels*/)
+{
+	stats.uploads++;
+	stats.texels += (long)width*height;
+	if (yoffset+height > stats.maxy)
+		stats.maxy = yoffset+height;
+}
+
+void glTexParameteri(GLenum /*target*/, GLenum /*pname*/, GLint /*param*/) {}
+void glTexEnvf(GLenum /*target*/, GLenum /*pname*/, GLfloat /*param*/) {}
+void glPixelStorei(GLenum /*pname*/, GLint /*param*/) {}
+void glEnable(GLenum /*cap*/) {}
+void glDisable(GLenum /*cap*/) {}
+void glEnableClientState(GLenum /*cap*/) {}
+void glDisableClientState(GLenum /*cap*/) {}
+void glVertexPointer(GLint /*size*/, GLenum /*type*/, GLsizei /*stride*/, const GLvoid* /*ptr*/) {}
+void glTexCoordPointer(GLint /*size*/, GLenum /*type*/, GLsizei /*stride*/, const GLvoid* /*ptr*/) {}
+void glColorPointer(GLint /*size*/, GLenum /*type*/, GLsizei /*stride*/, const GLvoid* /*ptr*/) {}
+
+void glDrawArrays(GLenum /*mode*/, GLint /*first*/, GLsizei count)
+{
+	stats.draws++;
+	stats.verts += count;
+}
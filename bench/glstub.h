@@ -0,0 +1,21 @@
+#ifndef GLSTUB_H
+#define GLSTUB_H
+
+// Headless stand-in for the handful of GL entry points fontstash uses. The
+// benchmark links against this instead of a real GL library, so it runs
+// without a display or context. Texture uploads are counted so atlas
+// behaviour can be measured.
+
+struct glstub_stats
+{
+	long uploads;     // glTexSubImage2D calls
+	long texels;      // texels uploaded by those calls
+	int maxy;         // lowest row touched by an upload
+	long draws;       // glDrawArrays calls
+	long verts;       // vertices submitted to glDrawArrays
+};
+
+void glstub_reset();
+const struct glstub_stats* glstub_get();
+
+#endif // GLSTUB_H
@@ -0,0 +1,42 @@
+#include "arena.h"
+
+Region::~Region() {
+  clear();
+  for (Chunk const& chunk: chunks)
+    ::operator delete(chunk.data);
+}
+
+void* Region::alloc(size_t size, size_t align) {
+  for (;;) {
+    if (current == chunks.size()) {
+      size_t n = size + align > chunkSize ? size + align : chunkSize;
+      chunks.push_back(Chunk{static_cast<char*>(::operator new(n)), n});
+    }
+    Chunk const& chunk = chunks[current];
+    size_t start = (reinterpret_cast<size_t>(chunk.data) + used + align - 1) & ~(align - 1);
+    size_t offset = start - reinterpret_cast<size_t>(chunk.data);
+    if (offset + size <= chunk.size) {
+      used = offset + size;
+      return chunk.data + offset;
+    }
+    ++current;
+    used = 0;
+  }
+}
+
+void Region::clear() {
+  for (Dtor* d = dtors; d; d = d->next)
+    d->run(d->p);
+  dtors = nullptr;
+  current = 0;
+  used = 0;
+}
+
+void Arena::reset() {
+  last = frame;
+  frame = Stats();
+  if (region.use_count() == 1)
+    region->clear();
+  else
+    region = std::make_shared<Region>();
+}
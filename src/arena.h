@@ -0,0 +1,119 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump-allocated memory in chunks that are kept and reused. Objects with
+// destructors are recorded and destroyed when the region is cleared.
+struct Region {
+  static const size_t chunkSize = 64 * 1024;
+  struct Chunk {
+    char* data;
+    size_t size;
+  };
+  struct Dtor {
+    void (*run)(void*);
+    void* p;
+    Dtor* next;
+  };
+  std::vector<Chunk> chunks;
+  size_t current = 0; // chunk being filled
+  size_t used = 0;    // bytes of it
+  Dtor* dtors = nullptr;
+
+  Region() = default;
+  Region(Region const&) = delete;
+  Region& operator=(Region const&) = delete;
+  ~Region();
+
+  void* alloc(size_t size, size_t align);
+  template <typename T> static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+  // Space for a T whose destructor is to be run on clear(), after its record.
+  template <typename T> void* allocWithDtor() {
+    const size_t offset = (sizeof(Dtor) + alignof(T) - 1) / alignof(T) * alignof(T);
+    char* p = static_cast<char*>(alloc(offset + sizeof(T), alignof(T) > alignof(Dtor) ? alignof(T) : alignof(Dtor)));
+    Dtor* d = reinterpret_cast<Dtor*>(p);
+    *d = Dtor{&destroy<T>, p + offset, dtors};
+    dtors = d;
+    return p + offset;
+  }
+  // Destroys what was made here and starts over from the first chunk.
+  void clear();
+};
+
+// The frame arena: memory for continuations made while a frame is being
+// brought up to date, which are all done with when it ends. Graph::endFrame
+// makes it active and resets it afterwards, which gives the region back in
+// one step; only the destructors recorded in it are run one by one.
+//
+// Something kept past the frame (a timer, a reader, a suspended task) is
+// wrapped with promote() first, which hands the region over to the heap: it
+// lives on, shared, until the last such closure is gone, and the next frame
+// starts on a new region.
+struct Arena {
+  struct Stats {
+    long allocs = 0;
+    long bytes = 0;
+    long promoted = 0;
+  };
+  std::shared_ptr<Region> region;
+  int active = 0;
+  Stats frame; // so far this frame
+  Stats last;  // of the last frame ended
+
+  Arena(): region(std::make_shared<Region>()) {}
+
+  void* alloc(size_t size, size_t align) {
+    ++frame.allocs;
+    frame.bytes += static_cast<long>(size);
+    return region->alloc(size, align);
+  }
+  template <typename T, typename... A> T* make(A&&... a) {
+    ++frame.allocs;
+    frame.bytes += static_cast<long>(sizeof(T));
+    void* p = std::is_trivially_destructible<T>::value ? region->alloc(sizeof(T), alignof(T))
+                                                       : region->allocWithDtor<T>();
+    return new (p) T(std::forward<A>(a)...);
+  }
+  std::shared_ptr<Region> pin() {
+    ++frame.promoted;
+    return region;
+  }
+  void reset();
+};
+
+inline Arena& frameArena() {
+  static thread_local Arena arena;
+  return arena;
+}
+
+// A continuation living in the frame arena. It copies as a pointer, so a
+// std::function holding it keeps it inline.
+template <typename K> struct ArenaCont {
+  K* k;
+  template <typename... A> void operator()(A const&... a) const { (*k)(a...); }
+};
+
+template <typename K> struct Promoted {
+  std::shared_ptr<Region> region; // destroyed after k
+  K k;
+  template <typename... A> void operator()(A const&... a) const { k(a...); }
+};
+
+// Keeps the current frame's region, if any, for as long as the result is.
+inline std::shared_ptr<Region> holdFrame() {
+  Arena& arena = frameArena();
+  return arena.active ? arena.pin() : std::shared_ptr<Region>();
+}
+
+// Makes k safe to keep after the current frame ends.
+template <typename K> Promoted<K> promote(K const& k) {
+  return Promoted<K>{holdFrame(), k};
+}
+
+#endif // ARENA_H
@@ -0,0 +1,215 @@
+#ifndef CO_H
+#define CO_H
+
+#include "ex.h"
+
+// A second way to write Ex programs: as C++20 coroutines returning Task<T>,
+// which co_await any expression. Sequential logic is then one state machine
+// in one frame, instead of a closure per step. A Task is itself an
+// expression, so the two mix freely. Without coroutine support in the
+// compiler this header declares nothing.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define EX_COROUTINES
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+
+// Coroutine frames are recycled through free lists by size, one set per
+// thread, so after warming up a task takes nothing from the heap.
+struct FramePool {
+  static const size_t granule = 64;
+  static const size_t classes = 16; // frames up to 1KB; bigger ones use the heap
+  struct Free {
+    Free* next;
+  };
+  Free* free[classes] = {};
+  long allocated = 0; // frames taken from the heap
+  long reused = 0;
+
+  FramePool() = default;
+  FramePool(FramePool const&) = delete;
+  FramePool& operator=(FramePool const&) = delete;
+  ~FramePool() {
+    for (Free* f: free) {
+      while (f) {
+        Free* next = f->next;
+        ::operator delete(f);
+        f = next;
+      }
+    }
+  }
+
+  void* alloc(size_t size) {
+    size_t c = (size + granule - 1) / granule;
+    if (c < classes && free[c]) {
+      Free* f = free[c];
+      free[c] = f->next;
+      ++reused;
+      return f;
+    }
+    ++allocated;
+    return ::operator new(c < classes ? c * granule : size);
+  }
+
+  void dealloc(void* p, size_t size) {
+    size_t c = (size + granule - 1) / granule;
+    if (c >= classes) {
+      ::operator delete(p);
+      return;
+    }
+    Free* f = static_cast<Free*>(p);
+    f->next = free[c];
+    free[c] = f;
+  }
+};
+
+inline FramePool& framePool() {
+  static thread_local FramePool pool;
+  return pool;
+}
+
+template <typename A> struct Resume {
+  A* a;
+  template <typename... V> void operator()(V const&... v) const {
+    a->result(v...);
+    if (a->owner == &trampoline() && a->inside) {
+      a->ready = true;
+      return;
+    }
+    if (a->second()) a->h.resume();
+  }
+};
+
+// Runs e from co_await. If it finishes before returning, as most do, the
+// coroutine goes on without suspending; otherwise it is resumed from e's
+// continuation. That may run on another thread (see all() in pool.h), at the
+// same time as e returns, so then both sides swap a flag and whichever comes
+// second goes on with the coroutine.
+template <typename E> struct ExAwaiter {
+  using T = typename E::Type;
+  E const& e;
+  Result<T> result;
+  std::coroutine_handle<> h;
+  Trampoline* owner = nullptr; // of the thread suspending
+  bool inside = false;         // of e, on that thread
+  bool ready = false;          // finished there
+  std::atomic<bool> arrived{false};
+
+  explicit ExAwaiter(E const& e_): e(e_) {}
+  // Whether the other side has already been here.
+  bool second() { return arrived.exchange(true, std::memory_order_acq_rel); }
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> h_) {
+    h = h_;
+    owner = &trampoline();
+    inside = true;
+    e(Resume<ExAwaiter>{this});
+    inside = false;
+    return !ready && !second();
+  }
+  T await_resume() { return result.get(); }
+};
+
+template <typename T> struct Task;
+
+// A last reference cannot be copied by anyone else, so it is let go of
+// without a read-modify-write.
+template <typename P> void releaseTask(std::coroutine_handle<P> h) {
+  std::atomic<int>& refs = h.promise().refs;
+  if (refs.load(std::memory_order_acquire) == 1 || refs.fetch_sub(1, std::memory_order_acq_rel) == 1) h.destroy();
+}
+
+// Hands the result on once the body has returned. The frame is let go of
+// first, as the continuation may run for a long time.
+struct FinalAwaiter {
+  bool await_ready() const noexcept { return false; }
+  template <typename P> void await_suspend(std::coroutine_handle<P> h) noexcept { h.promise().finish(h); }
+  void await_resume() const noexcept {}
+};
+
+struct TaskPromiseBase {
+  std::atomic<int> refs{1}; // Task copies, plus one while running
+  bool started = false;
+  std::shared_ptr<Region> region; // the frame it was started in, if any
+
+  static void* operator new(size_t size) { return framePool().alloc(size); }
+  static void operator delete(void* p, size_t size) { framePool().dealloc(p, size); }
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() const { std::terminate(); }
+  template <typename E> ExAwaiter<E> await_transform(E const& e) const { return ExAwaiter<E>(e); }
+};
+
+template <typename T> struct TaskPromise: TaskPromiseBase {
+  Result<T> result;
+  F<void (T)> k;
+
+  Task<T> get_return_object();
+  void return_value(T const& v) { result(v); }
+  template <typename P> void finish(std::coroutine_handle<P> h) {
+    F<void (T)> k_ = std::move(k);
+    T v = result.get();
+    releaseTask(h);
+    k_(v);
+  }
+};
+
+template <> struct TaskPromise<void>: TaskPromiseBase {
+  F<void ()> k;
+
+  Task<void> get_return_object();
+  void return_void() const {}
+  template <typename P> void finish(std::coroutine_handle<P> h) {
+    F<void ()> k_ = std::move(k);
+    releaseTask(h);
+    k_();
+  }
+};
+
+// A coroutine that starts when it is run as an expression, which may happen
+// once, and finishes with what it co_returns. Copies share the frame, and
+// may be made and dropped on different threads.
+template <typename T> struct Task {
+  using Type = T;
+  using promise_type = TaskPromise<T>;
+  using Handle = std::coroutine_handle<promise_type>;
+  Handle h;
+
+  explicit Task(Handle h_): h(h_) {}
+  Task(Task const& o): h(o.h) { h.promise().refs.fetch_add(1, std::memory_order_relaxed); }
+  Task(Task&& o) noexcept: h(o.h) { o.h = nullptr; }
+  Task& operator=(Task o) {
+    std::swap(h, o.h);
+    return *this;
+  }
+  ~Task() { if (h) releaseTask(h); }
+
+  template <typename K> void operator()(K const& k) const {
+    promise_type& p = h.promise();
+    assert(!p.started);
+    p.started = true;
+    p.refs.fetch_add(1, std::memory_order_relaxed);
+    p.region = holdFrame();
+    p.k = k;
+    h.resume();
+  }
+};
+
+template <typename T> struct IsExpr<Task<T>>: std::true_type {};
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+#endif
+#endif
+
+#endif // CO_H
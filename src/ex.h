@@ -0,0 +1,307 @@
+#ifndef EX_H
+#define EX_H
+
+#include "arena.h"
+
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename S> using F = std::function<S>;
+
+template <typename T> struct ContOf {typedef void Type(T);};
+template <> struct ContOf<void> {typedef void Type();};
+
+// An expression is any type with a Type member and a call operator that runs
+// it and hands the result to a continuation. The combinators below keep the
+// concrete types of their operands, so a composed expression is one nested
+// value that inlines into straight-line code. Ex<T> is the type-erased form,
+// for where a single type is needed (parameters, containers, recursion); only
+// it allocates. The continuations it wraps while a frame is brought up to date
+// come from the frame arena.
+
+template <typename T, typename Body> struct Node;
+
+// Each step of a chain runs nested inside the one before, so a long chain
+// would take a stack frame per step; so does each Ex<T> of a deeply nested
+// expression, such as let(let(...)) built up at run time, when it is
+// started. While evalSync drives evaluation, a step or Ex<T> that finds
+// maxDepth already nested is queued instead; the stack then unwinds back to
+// evalSync, which runs it from there.
+struct Trampoline {
+  static const int maxDepth = 256;
+  std::deque<F<void ()>> queue;
+  int depth = 0;
+  bool driving = false;
+};
+
+inline Trampoline& trampoline() {
+  static thread_local Trampoline t;
+  return t;
+}
+
+struct Nested {
+  Trampoline& t;
+  Nested(Trampoline& t_): t(t_) { ++t.depth; }
+  ~Nested() { --t.depth; }
+};
+
+// Queues f(a...) for evalSync if the stack is already maxDepth deep, and
+// returns whether it did. The copies are not wrapped with promote(), so that
+// they keep their types; the frame's region is held alongside instead.
+template <typename Fn, typename... A> bool bounced(Trampoline& t, Fn const& f, A const&... a) {
+  if (!t.driving || t.depth < Trampoline::maxDepth) return false;
+  Fn f_ = f;
+  std::shared_ptr<Region> region = holdFrame();
+  t.queue.push_back([f_, a..., region] () { f_(a...); });
+  return true;
+}
+
+template <typename T> struct Ex {
+  using Type = T;
+  using Cont = F<typename ContOf<T>::Type>;
+  using Fn = F<void (Cont)>;
+  Fn fn;
+  Ex(Fn fn_): fn(std::move(fn_)) {}
+  template <typename Body> Ex(Node<T, Body> const& n): fn(n) {}
+  void operator()(Cont const& k) const {
+    Trampoline& t = trampoline();
+    if (bounced(t, *this, k)) return;
+    Nested nested(t);
+    fn(k);
+  }
+  template <typename K> void operator()(K const& k) const {
+    Trampoline& t = trampoline();
+    if (bounced(t, *this, k)) return;
+    Nested nested(t);
+    Arena& arena = frameArena();
+    if (arena.active)
+      fn(Cont(ArenaCont<K>{arena.make<K>(k)}));
+    else
+      fn(Cont(k));
+  }
+};
+
+using Void = Ex<void>;
+using Float = Ex<float>;
+
+template <typename T, typename Body> struct Node {
+  using Type = T;
+  Body body;
+  template <typename K> void operator()(K const& k) const { body(k); }
+};
+
+template <typename T, typename Body> Node<T, Body> node(Body const& body) {
+  return Node<T, Body>{body};
+}
+
+// The expression type returned by g when applied to the result of an
+// expression of type T.
+template <typename G, typename T> struct Apply {
+  using Type = typename std::decay<decltype(std::declval<G const&>()(std::declval<T>()))>::type;
+};
+template <typename G> struct Apply<G, void> {
+  using Type = typename std::decay<decltype(std::declval<G const&>()())>::type;
+};
+
+template <typename T> struct Lit {
+  T val;
+  template <typename K> void operator()(K const& k) const { k(val); }
+};
+
+// A literal of a literal type is a constant expression, and so is anything
+// folded from literals (see the arithmetic below): it can initialize a
+// constexpr variable and its value is known to the compiler.
+template <typename T> constexpr Node<T, Lit<T>> lit(T const& val) {
+  return Node<T, Lit<T>>{Lit<T>{val}};
+}
+
+// Whether an expression type is one whose value is fixed at compile time,
+// readable with constValue().
+template <typename E> struct IsConst: std::false_type {};
+template <typename T> struct IsConst<Node<T, Lit<T>>>: std::true_type {};
+
+template <typename T> constexpr T constValue(Node<T, Lit<T>> const& e) {
+  return e.body.val;
+}
+
+struct Never {
+  template <typename K> void operator()(K const&) const {
+    // Do nothing.
+  }
+};
+
+const Node<void, Never> waitForever = {};
+
+// Runs e, then the expression g returns for its result.
+template <typename G, typename K> struct LetCont {
+  G g;
+  K k;
+  template <typename... A> void operator()(A const&... a) const {
+    Trampoline& t = trampoline();
+    if (bounced(t, *this, a...)) return;
+    Nested nested(t);
+    g(a...)(k);
+  }
+};
+
+template <typename E, typename G> struct Let {
+  E e;
+  G g;
+  template <typename K> void operator()(K const& k) const { e(LetCont<G, K>{g, k}); }
+};
+
+template <typename E, typename G>
+Node<typename Apply<G, typename E::Type>::Type::Type, Let<E, G>> let(E const& e, G const& g) {
+  return {Let<E, G>{e, g}};
+}
+
+// Runs e and passes g of its result on.
+template <typename G, typename K> struct MapCont {
+  G g;
+  K k;
+  template <typename... A> void operator()(A const&... a) const {
+    Trampoline& t = trampoline();
+    if (bounced(t, *this, a...)) return;
+    Nested nested(t);
+    k(g(a...));
+  }
+};
+
+template <typename E, typename G> struct Map {
+  E e;
+  G g;
+  template <typename K> void operator()(K const& k) const { e(MapCont<G, K>{g, k}); }
+};
+
+template <typename E, typename G>
+Node<typename std::decay<decltype(std::declval<G const&>()(std::declval<typename E::Type>()))>::type, Map<E, G>>
+map(E const& e, G const& g) {
+  return {Map<E, G>{e, g}};
+}
+
+template <typename... A> struct ToVoid {typedef void Type;};
+
+// The expression types the arithmetic below applies to: nodes and Ex<T>
+// here, Var<T> and Val<E> in track.h, and Task<T> in co.h. Other types with
+// a Type member are left alone.
+template <typename E> struct IsExpr: std::false_type {};
+template <typename T, typename Body> struct IsExpr<Node<T, Body>>: std::true_type {};
+template <typename T> struct IsExpr<Ex<T>>: std::true_type {};
+
+// Runs a, then b, and passes op of both results on.
+template <typename Op, typename X, typename K> struct ZipRight {
+  X x;
+  K k;
+  template <typename Y> void operator()(Y const& y) const {
+    Trampoline& t = trampoline();
+    if (bounced(t, *this, y)) return;
+    Nested nested(t);
+    k(Op()(x, y));
+  }
+};
+
+template <typename Op, typename B, typename K> struct ZipLeft {
+  B b;
+  K k;
+  template <typename X> void operator()(X const& x) const { b(ZipRight<Op, X, K>{x, k}); }
+};
+
+template <typename Op, typename A, typename B> struct Zip {
+  A a;
+  B b;
+  template <typename K> void operator()(K const& k) const { a(ZipLeft<Op, B, K>{b, k}); }
+};
+
+// Arithmetic on expressions. Two literals fold into a literal at compile
+// time; anything else runs both operands when evaluated.
+#define EX_ARITHMETIC(op, Op) \
+  struct Op { \
+    template <typename X, typename Y> \
+    constexpr auto operator()(X const& x, Y const& y) const -> decltype(x op y) { return x op y; } \
+  }; \
+  template <typename A, typename B, \
+            typename = typename std::enable_if<IsExpr<A>::value && IsExpr<B>::value>::type> \
+  Node<decltype(std::declval<typename A::Type>() op std::declval<typename B::Type>()), Zip<Op, A, B>> \
+  operator op(A const& a, B const& b) { \
+    return {Zip<Op, A, B>{a, b}}; \
+  } \
+  template <typename T, typename U> \
+  constexpr Node<decltype(std::declval<T>() op std::declval<U>()), Lit<decltype(std::declval<T>() op std::declval<U>())>> \
+  operator op(Node<T, Lit<T>> const& a, Node<U, Lit<U>> const& b) { \
+    return lit(Op()(a.body.val, b.body.val)); \
+  }
+
+EX_ARITHMETIC(+, Plus)
+EX_ARITHMETIC(-, Minus)
+EX_ARITHMETIC(*, Times)
+EX_ARITHMETIC(/, Divides)
+
+#undef EX_ARITHMETIC
+
+// Gives g an expression that, when run, abandons its own continuation and
+// finishes the callCc instead.
+template <typename G> struct CallCc {
+  G g;
+  template <typename K> void operator()(K const& k) const {
+    g(Void([k] (Void::Cont) { k(); }))(k);
+  }
+};
+
+template <typename G> Node<typename Apply<G, Void>::Type::Type, CallCc<G>> callCc(G const& g) {
+  return {CallCc<G>{g}};
+}
+
+template <typename T> struct Result {
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+  bool set = false;
+  ~Result() { if (set) get().~T(); }
+  T& get() { return *reinterpret_cast<T*>(&buf); }
+  void operator()(T const& v) {
+    assert(!set);
+    new (&buf) T(v);
+    set = true;
+  }
+};
+
+template <> struct Result<void> {
+  bool set = false;
+  void get() {}
+  void operator()() { set = true; }
+};
+
+template <typename T> struct SetResult {
+  Result<T>* r;
+  template <typename... A> void operator()(A const&... a) const { (*r)(a...); }
+};
+
+// Blocks until a timer, input source or post from another thread lets
+// evaluation go on, and runs what was waiting for it. In loop.cpp.
+void waitForEvents();
+
+// Runs e to completion on this thread, in bounded stack however many steps
+// it takes. While nothing is ready to run it sleeps in waitForEvents().
+template <typename E> typename E::Type evalSync(E const& e) {
+  using T = typename E::Type;
+  Trampoline& t = trampoline();
+  bool driving = t.driving;
+  Result<T> r;
+  t.driving = true;
+  e(SetResult<T>{&r});
+  while (!r.set) {
+    if (t.queue.empty()) {
+      waitForEvents();
+      continue;
+    }
+    F<void ()> step = std::move(t.queue.front());
+    t.queue.pop_front();
+    step();
+  }
+  t.driving = driving;
+  return r.get();
+}
+
+#endif // EX_H
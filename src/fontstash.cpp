@@ -4,19 +4,43 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
 #include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
 
 #define STB_TRUETYPE_IMPLEMENTATION
-#define STBTT_malloc(x,u)    malloc(x)
-#define STBTT_free(x,u)      free(x)
+#define STBTT_ARENA
 #include "stb_truetype.h"
 
 #define HASH_LUT_SIZE 256
 #define MAX_ROWS 128
-#define MAX_FONTS 4
 #define VERT_COUNT (6*128)
 #define VERT_SIZE 8
 #define VERT_STRIDE (sizeof(float)*VERT_SIZE)
+#define OUTLINE_CACHE_SIZE (256*1024)
+#define MAX_THREADS 16
+#define BATCH_CHUNK 4
+#define TILE_SIZE 64
+#define TILED_GLYPH_SIZE (2*TILE_SIZE)
+
+#define LOAD_PENDING 0
+#define LOAD_DONE 1
+#define LOAD_FAILED 2
 
 static unsigned int hashint(unsigned int a)
 {
@@ -48,29 +72,144 @@ struct sth_glyph
 	int x0,y0,x1,y1;
 	float xadv,xoff,yoff;
 	int next;
+	int tile,ntiles;	// tile is -1 unless the glyph is stored in tiles
+};
+
+// Piece of a glyph too large to keep in one place in the texture. Only
+// pieces with some coverage are stored.
+struct sth_tile
+{
+	short x,y;
+	int x0,y0,x1,y1;
+};
+
+// Parsed glyph outline, kept so that rendering a glyph at another size
+// does not parse its glyf data again.
+struct sth_outline
+{
+	int glyph;
+	stbtt_vertex* verts;
+	int nverts;
+	int next;
+	int older,newer;
+};
+
+// Glyph outline cut into triangles, for text too large to be worth keeping
+// in the texture. Points are in font units, flattened finely enough for
+// every size up to 'size', and down to half of it.
+struct sth_mesh
+{
+	unsigned int codepoint;
+	float size;
+	int advance;
+	int x0,y0,x1,y1;
+	int first,ntris;	// into sth_font::mesh_verts, 6 floats per triangle
+	int next;
+};
+
+// Font file, mapped once and shared by every slot that uses one of the
+// faces in it.
+struct sth_file
+{
+	char* path;
+	unsigned char* data;
+	int size;
+	int mapped;
+	int refs;
+	struct sth_file* next;
+};
+
+// Which font a code point is drawn with, as found by resolve().
+struct sth_resolved
+{
+	unsigned int codepoint;
+	int font;
+	int next;
 };
 
 struct sth_font
 {
 	stbtt_fontinfo font;
-	unsigned char* data;
-	int datasize;
+	struct sth_file* file;
 	struct sth_glyph* glyphs;
 	int lut[HASH_LUT_SIZE];
 	int nglyphs;
+	struct sth_tile* tiles;
+	int ntiles, ctiles;
+	struct sth_outline* outlines;
+	int outline_lut[HASH_LUT_SIZE];
+	int noutlines, coutlines;
+	int outline_free;
+	int outline_newest, outline_oldest;
+	int outline_bytes;
+	struct sth_mesh* meshes;
+	int mesh_lut[HASH_LUT_SIZE];
+	int nmeshes, cmeshes;
+	float* mesh_verts;
+	int nmesh_verts, cmesh_verts;
+	int* fallbacks;
+	int nfallbacks;
+	struct sth_resolved* resolved;
+	int resolved_lut[HASH_LUT_SIZE];
+	int nresolved, cresolved;
+	unsigned int resolved_gen;
+	struct sth_load* load;
 	float ascender;
 	float descender;
 	float lineh;
 };
 
+// Threads that rasterize glyph batches for sth_prewarm. The calling thread
+// takes part as worker 0, so a pool with no threads rasterizes in place.
+// Each worker renders with its own copy of the font info and scratch arena.
+struct sth_pool
+{
+	std::thread threads[MAX_THREADS];
+	stbtt_arena scratch[MAX_THREADS];
+	int nthreads;
+	std::mutex lock;
+	std::condition_variable start, done;
+	unsigned int batch;
+	int busy;
+	bool quit;
+	const stbtt_fontinfo* font;
+	unsigned char* out;
+	int stride;
+	const stbtt_glyphjob* jobs;
+	int njobs;
+	std::atomic<int> next;
+};
+
+// Font being opened on a background thread by sth_add_font_async. The
+// thread fills in 'font' and then sets 'state'; the slot takes the font
+// over on the calling thread the next time it is used.
+struct sth_load
+{
+	std::thread thread;
+	std::atomic<int> state;
+	char* path;
+	int face;
+	struct sth_file* shared;	// the stash's copy of the file, if it had one
+	struct sth_font font;
+};
+
 struct sth_stash
 {
 	int tw,th;
 	float itw,ith;
 	GLuint tex;
+	stbtt_arena scratch;
+	int outline_budget;
+	float vector_size;
+	int has_white;
+	float white_s, white_t;
+	struct sth_pool* pool;
 	struct sth_row rows[MAX_ROWS];
 	int nrows;
-	struct sth_font fonts[MAX_FONTS];
+	struct sth_font* fonts;
+	int nfonts, cfonts;
+	struct sth_file* files;
+	unsigned int generation;	// bumped whenever what resolve() finds may change
 	float verts[VERT_SIZE*VERT_COUNT];
 	int nverts;
 	int drawing;
@@ -113,6 +252,237 @@ static unsigned int decutf8(unsigned int* state, unsigned int* codep, unsigned i
 
 
 
+static int outline_size(int nverts)
+{
+	return (int)(sizeof(struct sth_outline) + (unsigned)nverts*sizeof(stbtt_vertex));
+}
+
+static void unlink_outline(struct sth_font* fnt, int i)
+{
+	struct sth_outline* o = &fnt->outlines[i];
+	if (o->newer != -1)
+		fnt->outlines[o->newer].older = o->older;
+	else
+		fnt->outline_newest = o->older;
+	if (o->older != -1)
+		fnt->outlines[o->older].newer = o->newer;
+	else
+		fnt->outline_oldest = o->newer;
+}
+
+static void link_outline(struct sth_font* fnt, int i)
+{
+	struct sth_outline* o = &fnt->outlines[i];
+	o->older = fnt->outline_newest;
+	o->newer = -1;
+	if (o->older != -1)
+		fnt->outlines[o->older].newer = i;
+	else
+		fnt->outline_oldest = i;
+	fnt->outline_newest = i;
+}
+
+// Drops the least recently used outline.
+static void evict_outline(struct sth_font* fnt)
+{
+	int i = fnt->outline_oldest;
+	int* p;
+	struct sth_outline* o;
+	if (i == -1) return;
+	o = &fnt->outlines[i];
+	unlink_outline(fnt, i);
+	p = &fnt->outline_lut[hashint((unsigned int)o->glyph) & (HASH_LUT_SIZE-1)];
+	while (*p != i)
+		p = &fnt->outlines[*p].next;
+	*p = o->next;
+	fnt->outline_bytes -= outline_size(o->nverts);
+	free(o->verts);
+	o->verts = NULL;
+	o->next = fnt->outline_free;
+	fnt->outline_free = i;
+}
+
+static void free_outlines(struct sth_font* fnt)
+{
+	int i;
+	if (!fnt->outlines) return;
+	for (i = 0; i < fnt->noutlines; ++i)
+		free(fnt->outlines[i].verts);
+	free(fnt->outlines);
+	fnt->outlines = NULL;
+}
+
+static void free_meshes(struct sth_font* fnt)
+{
+	free(fnt->meshes);
+	free(fnt->mesh_verts);
+	fnt->meshes = NULL;
+	fnt->mesh_verts = NULL;
+}
+
+// Returns the cache slot holding the outline of glyph g and makes it the
+// most recently used, or -1 if it is not cached.
+static int find_outline(struct sth_font* fnt, int g)
+{
+	int i = fnt->outline_lut[hashint((unsigned int)g) & (HASH_LUT_SIZE-1)];
+	while (i != -1)
+	{
+		if (fnt->outlines[i].glyph == g)
+		{
+			unlink_outline(fnt, i);
+			link_outline(fnt, i);
+			return i;
+		}
+		i = fnt->outlines[i].next;
+	}
+	return -1;
+}
+
+// Returns the outline of glyph g, from the cache if possible. Outlines that
+// do not fit in the cache are left in the scratch arena, so the result is
+// only valid until the next arena reset.
+static stbtt_vertex* get_outline(struct sth_stash* stash, struct sth_font* fnt, int g, int* nverts)
+{
+	unsigned int h = hashint((unsigned int)g) & (HASH_LUT_SIZE-1);
+	int i, size;
+	stbtt_vertex* verts;
+	struct sth_outline* o;
+
+	i = find_outline(fnt, g);
+	if (i != -1)
+	{
+		*nverts = fnt->outlines[i].nverts;
+		return fnt->outlines[i].verts;
+	}
+
+	*nverts = stbtt_GetGlyphShape(&fnt->font, g, &verts);
+	size = outline_size(*nverts);
+	if (size > stash->outline_budget)
+		return verts;
+	while (fnt->outline_bytes + size > stash->outline_budget)
+		evict_outline(fnt);
+
+	// Take a free slot, or grow the slot array.
+	if (fnt->outline_free != -1)
+	{
+		i = fnt->outline_free;
+		fnt->outline_free = fnt->outlines[i].next;
+	}
+	else
+	{
+		if (fnt->noutlines == fnt->coutlines)
+		{
+			int n = fnt->coutlines ? fnt->coutlines*2 : 64;
+			o = (struct sth_outline*)realloc(fnt->outlines, (unsigned)n*sizeof(struct sth_outline));
+			if (!o) return verts;
+			fnt->outlines = o;
+			fnt->coutlines = n;
+		}
+		i = fnt->noutlines++;
+	}
+
+	o = &fnt->outlines[i];
+	o->verts = NULL;
+	if (*nverts)
+	{
+		o->verts = (stbtt_vertex*)malloc((unsigned)*nverts*sizeof(stbtt_vertex));
+		if (!o->verts)
+		{
+			o->next = fnt->outline_free;
+			fnt->outline_free = i;
+			return verts;
+		}
+		memcpy(o->verts, verts, (unsigned)*nverts*sizeof(stbtt_vertex));
+	}
+	o->glyph = g;
+	o->nverts = *nverts;
+	o->next = fnt->outline_lut[h];
+	fnt->outline_lut[h] = i;
+	link_outline(fnt, i);
+	fnt->outline_bytes += size;
+
+	return o->verts;
+}
+
+static void run_jobs(struct sth_pool* pool, int worker)
+{
+	stbtt_fontinfo font = *pool->font;
+	int i, n;
+	font.userdata = &pool->scratch[worker];
+	for (;;)
+	{
+		i = pool->next.fetch_add(BATCH_CHUNK);
+		if (i >= pool->njobs) break;
+		n = pool->njobs-i < BATCH_CHUNK ? pool->njobs-i : BATCH_CHUNK;
+		stbtt_MakeGlyphBitmaps(&font, pool->out, pool->stride, pool->jobs+i, n);
+	}
+}
+
+static void pool_worker(struct sth_pool* pool, int worker, unsigned int batch)
+{
+	std::unique_lock<std::mutex> l(pool->lock);
+	for (;;)
+	{
+		while (!pool->quit && pool->batch == batch)
+			pool->start.wait(l);
+		if (pool->quit) return;
+		batch = pool->batch;
+		l.unlock();
+		run_jobs(pool, worker);
+		l.lock();
+		if (--pool->busy == 0)
+			pool->done.notify_one();
+	}
+}
+
+static void stop_pool(struct sth_pool* pool)
+{
+	int i;
+	{
+		std::lock_guard<std::mutex> l(pool->lock);
+		pool->quit = true;
+	}
+	pool->start.notify_all();
+	for (i = 1; i <= pool->nthreads; ++i)
+		pool->threads[i].join();
+	pool->nthreads = 0;
+	pool->quit = false;
+}
+
+static void delete_pool(struct sth_pool* pool)
+{
+	int i;
+	if (pool == NULL) return;
+	stop_pool(pool);
+	for (i = 0; i < MAX_THREADS; ++i)
+		stbtt_ArenaRelease(&pool->scratch[i]);
+	delete pool;
+}
+
+// Rasterizes the jobs into 'out' on every thread of the pool, and returns
+// once all of them are done.
+static void run_batch(struct sth_pool* pool, const stbtt_fontinfo* font, unsigned char* out, int stride,
+					  const stbtt_glyphjob* jobs, int njobs)
+{
+	std::unique_lock<std::mutex> l(pool->lock);
+	pool->font = font;
+	pool->out = out;
+	pool->stride = stride;
+	pool->jobs = jobs;
+	pool->njobs = njobs;
+	pool->next = 0;
+	pool->busy = pool->nthreads;
+	pool->batch++;
+	l.unlock();
+	pool->start.notify_all();
+
+	run_jobs(pool, 0);
+
+	l.lock();
+	while (pool->busy)
+		pool->done.wait(l);
+}
+
 struct sth_stash* sth_create(int cachew, int cacheh)
 {
 	struct sth_stash* stash;
@@ -122,6 +492,16 @@ struct sth_stash* sth_create(int cachew, int cacheh)
 	if (stash == NULL) goto error;
 	memset(stash,0,sizeof(struct sth_stash));
 
+	// Scratch memory for rasterizing; grows to fit the largest glyph seen.
+	stbtt_ArenaInit(&stash->scratch, 64*1024);
+	stash->outline_budget = OUTLINE_CACHE_SIZE;
+	// Meshes are off until sth_set_vector_size() asks for them.
+
+	stash->pool = new (std::nothrow) sth_pool();
+	if (stash->pool == NULL) goto error;
+	for (int i = 0; i < MAX_THREADS; ++i)
+		stbtt_ArenaInit(&stash->pool->scratch[i], 0);
+
 	// Create texture for the cache.
 	stash->tw = cachew;
 	stash->th = cacheh;
@@ -137,42 +517,185 @@ struct sth_stash* sth_create(int cachew, int cacheh)
 
 error:
 	if (stash != NULL)
+	{
+		delete_pool(stash->pool);
+		stbtt_ArenaRelease(&stash->scratch);
 		free(stash);
+	}
 	return NULL;
 }
 
-int sth_add_font(struct sth_stash* stash, int idx, const char* path)
+void sth_set_threads(struct sth_stash* stash, int count)
 {
-	FILE* fp = 0;
-	int i, ascent, descent, fh, lineGap;
-	struct sth_font* fnt;
+	struct sth_pool* pool;
+	int i;
+	if (stash == NULL) return;
+	pool = stash->pool;
+	stop_pool(pool);
+	if (count > MAX_THREADS) count = MAX_THREADS;
+	for (i = 1; i < count; ++i)
+	{
+		pool->threads[i] = std::thread(pool_worker, pool, i, pool->batch);
+		pool->nthreads = i;
+	}
+}
 
-	if (idx < 0 || idx >= MAX_FONTS) return 0;
+// Text at or above 'size' pixels is drawn from triangle meshes instead of
+// the texture; 0, the default, turns that off. Mesh edges are not
+// antialiased, so such text looks rougher than bitmap glyphs of the same size
+// would; it is for sizes where the atlas would not hold the bitmaps.
+void sth_set_vector_size(struct sth_stash* stash, float size)
+{
+	if (stash == NULL) return;
+	stash->vector_size = size > 0 ? size : 0;
+}
 
-	fnt = &stash->fonts[idx];
-	if (fnt->data)
-		free(fnt->data);
-	if (fnt->glyphs)
-		free(fnt->glyphs);
-	memset(fnt,0,sizeof(struct sth_font));
+void sth_set_outline_cache(struct sth_stash* stash, int bytes)
+{
+	int i;
+	if (stash == NULL) return;
+	stash->outline_budget = bytes > 0 ? bytes : 0;
+	for (i = 0; i < stash->nfonts; ++i)
+	{
+		while (stash->fonts[i].outline_bytes > stash->outline_budget)
+			evict_outline(&stash->fonts[i]);
+	}
+}
 
-	// Init hash lookup.
-	for (i = 0; i < HASH_LUT_SIZE; ++i) fnt->lut[i] = -1;
+// Maps the font file instead of reading it in, so that loading takes the
+// same time whatever the size of the file. Only the pages stb_truetype
+// touches are read: the table directory and metrics tables at init, and
+// glyf/loca ranges as glyphs are first used. Falls back to reading the
+// whole file where the file cannot be mapped.
+static int read_file(struct sth_file* file)
+{
+	FILE* fp;
+
+#ifndef _WIN32
+	struct stat st;
+	int fd = open(file->path, O_RDONLY);
+	if (fd == -1) return 0;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			// Glyphs are looked up all over the file; read-ahead would
+			// page in neighbours that may never be drawn.
+			madvise(p, (size_t)st.st_size, MADV_RANDOM);
+			file->data = (unsigned char*)p;
+			file->size = (int)st.st_size;
+			file->mapped = 1;
+		}
+	}
+	close(fd);
+	if (file->data) return 1;
+#endif
 
-	// Read in the font data.
-	fp = fopen(path, "rb");
-	if (!fp) goto error;
+	fp = fopen(file->path, "rb");
+	if (!fp) return 0;
 	fseek(fp,0,SEEK_END);
-	fnt->datasize = (int)ftell(fp);
+	file->size = (int)ftell(fp);
 	fseek(fp,0,SEEK_SET);
-	fnt->data = (unsigned char*)malloc((size_t)fnt->datasize);
-	if (fnt->data == NULL) goto error;
-	fread(fnt->data, 1, (size_t)fnt->datasize, fp);
+	file->data = (unsigned char*)malloc((size_t)file->size);
+	if (file->data && fread(file->data, 1, (size_t)file->size, fp) != (size_t)file->size)
+	{
+		free(file->data);
+		file->data = NULL;
+	}
 	fclose(fp);
-	fp = 0;
+	return file->data != NULL;
+}
+
+static void free_file(struct sth_file* file)
+{
+	if (!file) return;
+#ifndef _WIN32
+	if (file->mapped)
+		munmap(file->data, (size_t)file->size);
+	else
+#endif
+		free(file->data);
+	free(file->path);
+	free(file);
+}
+
+// Loads the file with a single reference to it, not shared with the stash.
+static struct sth_file* load_file(const char* path)
+{
+	size_t n = strlen(path)+1;
+	struct sth_file* file = (struct sth_file*)calloc(1, sizeof(struct sth_file));
+	if (file == NULL) return NULL;
+	file->path = (char*)malloc(n);
+	if (file->path == NULL)
+	{
+		free(file);
+		return NULL;
+	}
+	memcpy(file->path, path, n);
+	file->refs = 1;
+	if (!read_file(file))
+	{
+		free_file(file);
+		return NULL;
+	}
+	return file;
+}
+
+static struct sth_file* find_file(struct sth_stash* stash, const char* path)
+{
+	struct sth_file* file;
+	for (file = stash->files; file; file = file->next)
+	{
+		if (strcmp(file->path, path) == 0)
+			return file;
+	}
+	return NULL;
+}
+
+// Returns the stash's copy of the file, loading it if no slot uses it yet.
+static struct sth_file* open_file(struct sth_stash* stash, const char* path)
+{
+	struct sth_file* file = find_file(stash, path);
+	if (file)
+	{
+		file->refs++;
+		return file;
+	}
+	file = load_file(path);
+	if (file == NULL) return NULL;
+	file->next = stash->files;
+	stash->files = file;
+	return file;
+}
+
+static void release_file(struct sth_stash* stash, struct sth_file* file)
+{
+	struct sth_file** p;
+	if (!file || --file->refs > 0) return;
+	for (p = &stash->files; *p; p = &(*p)->next)
+	{
+		if (*p == file)
+		{
+			*p = file->next;
+			break;
+		}
+	}
+	free_file(file);
+}
+
+// Reads the metrics of face 'face' of the file into 'fnt', which is
+// expected to be empty, and has it refer to the file. Touches nothing but
+// 'fnt', so it can run on any thread.
+static int open_font(struct sth_font* fnt, struct sth_file* file, int face)
+{
+	int ascent, descent, fh, lineGap, offset;
 
 	// Init stb_truetype
-	if (!stbtt_InitFont(&fnt->font, fnt->data, 0)) goto error;
+	offset = stbtt_GetFontOffsetForIndex(file->data, face);
+	if (offset < 0 || offset >= file->size) return 0;
+	if (!stbtt_InitFont(&fnt->font, file->data, offset)) return 0;
+	fnt->file = file;
 
 	// Store normalized line height. The real line height is got
 	// by multiplying the lineh by font size.
@@ -183,51 +706,333 @@ int sth_add_font(struct sth_stash* stash, int idx, const char* path)
 	fnt->lineh = (float)(fh + lineGap) / (float)fh;
 
 	return 1;
+}
 
-error:
-	if (fnt->data) free(fnt->data);
-	if (fnt->glyphs) free(fnt->glyphs);
+// Opens the face on a background thread. The file is the stash's copy if it
+// was open already, and is otherwise loaded here.
+static void load_worker(struct sth_load* load, struct sth_file* file)
+{
+	if (file == NULL)
+	{
+		file = load_file(load->path);
+		if (file == NULL)
+		{
+			load->state = LOAD_FAILED;
+			return;
+		}
+	}
+	load->font.file = file;
+	load->state = open_font(&load->font, file, load->face) ? LOAD_DONE : LOAD_FAILED;
+}
+
+static void delete_load(struct sth_load* load)
+{
+	free(load->path);
+	delete load;
+}
+
+// Waits for the load and returns the file it opened, now counted in the
+// stash: a file it loaded itself is added to the stash's files, unless the
+// same file was opened meanwhile, in which case that copy is used.
+static struct sth_file* join_load(struct sth_stash* stash, struct sth_load* load)
+{
+	struct sth_file* file;
+	struct sth_file* other;
+
+	load->thread.join();
+	file = load->font.file;
+	if (file == NULL || file == load->shared) return file;
+	other = find_file(stash, file->path);
+	if (other)
+	{
+		other->refs++;
+		free_file(file);
+		return other;
+	}
+	file->next = stash->files;
+	stash->files = file;
+	return file;
+}
+
+// Empties the slot, waiting for and dropping a background load into it.
+static void clear_font(struct sth_stash* stash, int idx)
+{
+	struct sth_font* fnt = &stash->fonts[idx];
+	struct sth_load* load = fnt->load;
+	int i;
+
+	if (load)
+	{
+		release_file(stash, join_load(stash, load));
+		delete_load(load);
+	}
+
+	release_file(stash, fnt->file);
+	if (fnt->glyphs)
+		free(fnt->glyphs);
+	if (fnt->tiles)
+		free(fnt->tiles);
+	free_outlines(fnt);
+	free_meshes(fnt);
+	free(fnt->fallbacks);
+	free(fnt->resolved);
 	memset(fnt,0,sizeof(struct sth_font));
-	if (fp) fclose(fp);
-	return 0;
+
+	// Init hash lookup.
+	for (i = 0; i < HASH_LUT_SIZE; ++i) fnt->lut[i] = -1;
+	for (i = 0; i < HASH_LUT_SIZE; ++i) fnt->outline_lut[i] = -1;
+	for (i = 0; i < HASH_LUT_SIZE; ++i) fnt->mesh_lut[i] = -1;
+	fnt->outline_free = -1;
+	fnt->outline_newest = fnt->outline_oldest = -1;
+
+	stash->generation++;
 }
 
-static struct sth_glyph* get_glyph(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, short isize)
+// Makes sure slot idx exists, adding empty slots as needed.
+static int reserve_font(struct sth_stash* stash, int idx)
 {
-	int i,g,advance,lsb,x0,y0,x1,y1,gw,gh;
-	float scale;
-	struct sth_glyph* glyph;
-	unsigned char* bmp;
-	unsigned int h;
-	float size = isize/10.0f;
-	int rh;
-	struct sth_row* br;
+	struct sth_font* fonts;
+	int n;
 
-	// Find code point and size.
-	h = hashint(codepoint) & (HASH_LUT_SIZE-1);
-	i = fnt->lut[h];
+	if (idx < stash->nfonts) return 1;
+	if (idx >= stash->cfonts)
+	{
+		n = stash->cfonts ? stash->cfonts*2 : 4;
+		while (n <= idx)
+			n *= 2;
+		fonts = (struct sth_font*)realloc(stash->fonts, (unsigned)n*sizeof(struct sth_font));
+		if (!fonts) return 0;
+		stash->fonts = fonts;
+		stash->cfonts = n;
+	}
+	memset(&stash->fonts[stash->nfonts], 0, (unsigned)(idx+1-stash->nfonts)*sizeof(struct sth_font));
+	stash->nfonts = idx+1;
+	return 1;
+}
+
+// Moves a finished background load into its slot.
+static void finish_load(struct sth_stash* stash, int idx)
+{
+	struct sth_font* fnt;
+	struct sth_load* load;
+	struct sth_file* file;
+
+	if (idx < 0 || idx >= stash->nfonts) return;
+	fnt = &stash->fonts[idx];
+	load = fnt->load;
+	if (!load || load->state == LOAD_PENDING) return;
+
+	file = join_load(stash, load);
+	if (load->state != LOAD_DONE)
+		release_file(stash, file);
+	else
+	{
+		fnt->file = file;
+		fnt->font = load->font.font;
+		fnt->font.data = file->data;
+		fnt->font.userdata = &stash->scratch;
+		fnt->ascender = load->font.ascender;
+		fnt->descender = load->font.descender;
+		fnt->lineh = load->font.lineh;
+		stash->generation++;
+	}
+	delete_load(load);
+	fnt->load = NULL;
+}
+
+// Returns the font in the slot, or NULL if there is none yet. Background
+// loads into the slot or its fallbacks that have finished are taken over
+// here.
+static struct sth_font* get_font(struct sth_stash* stash, int idx)
+{
+	struct sth_font* fnt;
+	int i;
+
+	if (idx < 0 || idx >= stash->nfonts) return NULL;
+	fnt = &stash->fonts[idx];
+	finish_load(stash, idx);
+	for (i = 0; i < fnt->nfallbacks; ++i)
+		finish_load(stash, fnt->fallbacks[i]);
+	return fnt->file ? fnt : NULL;
+}
+
+// Returns the font to draw the code point with: this one if it has a glyph
+// for it, or else the first of its fallbacks that does, or this one again
+// if none does. The answers are remembered until a font is added or a
+// fallback chain changes, so the cmaps are only searched once per code
+// point.
+static struct sth_font* resolve(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint)
+{
+	unsigned int h = hashint(codepoint) & (HASH_LUT_SIZE-1);
+	struct sth_resolved* r;
+	struct sth_font* f;
+	int i, found;
+
+	if (fnt->nfallbacks == 0) return fnt;
+
+	if (fnt->resolved_gen != stash->generation)
+	{
+		for (i = 0; i < HASH_LUT_SIZE; ++i) fnt->resolved_lut[i] = -1;
+		fnt->nresolved = 0;
+		fnt->resolved_gen = stash->generation;
+	}
+	for (i = fnt->resolved_lut[h]; i != -1; i = fnt->resolved[i].next)
+	{
+		if (fnt->resolved[i].codepoint == codepoint)
+			return &stash->fonts[fnt->resolved[i].font];
+	}
+
+	found = (int)(fnt - stash->fonts);
+	if (!stbtt_FindGlyphIndex(&fnt->font, (int)codepoint))
+	{
+		for (i = 0; i < fnt->nfallbacks; ++i)
+		{
+			f = fnt->fallbacks[i] < stash->nfonts ? &stash->fonts[fnt->fallbacks[i]] : NULL;
+			if (f && f->file && stbtt_FindGlyphIndex(&f->font, (int)codepoint))
+			{
+				found = fnt->fallbacks[i];
+				break;
+			}
+		}
+	}
+
+	if (fnt->nresolved == fnt->cresolved)
+	{
+		int n = fnt->cresolved ? fnt->cresolved*2 : 64;
+		r = (struct sth_resolved*)realloc(fnt->resolved, (unsigned)n*sizeof(struct sth_resolved));
+		if (!r) return &stash->fonts[found];
+		fnt->resolved = r;
+		fnt->cresolved = n;
+	}
+	r = &fnt->resolved[fnt->nresolved];
+	r->codepoint = codepoint;
+	r->font = found;
+	r->next = fnt->resolved_lut[h];
+	fnt->resolved_lut[h] = fnt->nresolved++;
+
+	return &stash->fonts[found];
+}
+
+int sth_add_font_face(struct sth_stash* stash, int idx, const char* path, int face)
+{
+	struct sth_font* fnt;
+	struct sth_file* file;
+
+	if (idx < 0 || !reserve_font(stash, idx)) return 0;
+
+	clear_font(stash, idx);
+	fnt = &stash->fonts[idx];
+	file = open_file(stash, path);
+	if (file == NULL) return 0;
+	if (!open_font(fnt, file, face))
+	{
+		release_file(stash, file);
+		return 0;
+	}
+	fnt->font.userdata = &stash->scratch;
+
+	return 1;
+}
+
+int sth_add_font(struct sth_stash* stash, int idx, const char* path)
+{
+	return sth_add_font_face(stash, idx, path, 0);
+}
+
+int sth_add_font_face_async(struct sth_stash* stash, int idx, const char* path, int face)
+{
+	struct sth_load* load;
+	size_t n;
+
+	if (stash == NULL) return 0;
+	if (idx < 0 || !reserve_font(stash, idx)) return 0;
+
+	clear_font(stash, idx);
+	load = new (std::nothrow) sth_load();
+	if (load == NULL) return 0;
+	n = strlen(path)+1;
+	load->path = (char*)malloc(n);
+	if (load->path == NULL)
+	{
+		delete load;
+		return 0;
+	}
+	memcpy(load->path, path, n);
+	load->face = face;
+	load->state = LOAD_PENDING;
+	load->shared = find_file(stash, path);
+	if (load->shared)
+		load->shared->refs++;
+	load->thread = std::thread(load_worker, load, load->shared);
+	stash->fonts[idx].load = load;
+
+	return 1;
+}
+
+int sth_add_font_async(struct sth_stash* stash, int idx, const char* path)
+{
+	return sth_add_font_face_async(stash, idx, path, 0);
+}
+
+int sth_font_ready(struct sth_stash* stash, int idx)
+{
+	if (stash == NULL) return -1;
+	if (idx < 0 || idx >= stash->nfonts) return -1;
+	if (stash->fonts[idx].load && stash->fonts[idx].load->state == LOAD_PENDING) return 0;
+	return get_font(stash, idx) ? 1 : -1;
+}
+
+int sth_add_fallback(struct sth_stash* stash, int idx, int fallback)
+{
+	struct sth_font* fnt;
+	int* fallbacks;
+
+	if (stash == NULL) return 0;
+	if (idx < 0 || idx >= stash->nfonts) return 0;
+	if (fallback < 0 || fallback == idx) return 0;
+	fnt = &stash->fonts[idx];
+	fallbacks = (int*)realloc(fnt->fallbacks, (unsigned)(fnt->nfallbacks+1)*sizeof(int));
+	if (!fallbacks) return 0;
+	fnt->fallbacks = fallbacks;
+	fnt->fallbacks[fnt->nfallbacks++] = fallback;
+	stash->generation++;
+	return 1;
+}
+
+void sth_reset_fallbacks(struct sth_stash* stash, int idx)
+{
+	if (stash == NULL) return;
+	if (idx < 0 || idx >= stash->nfonts) return;
+	free(stash->fonts[idx].fallbacks);
+	stash->fonts[idx].fallbacks = NULL;
+	stash->fonts[idx].nfallbacks = 0;
+	stash->generation++;
+}
+
+static struct sth_glyph* find_glyph(struct sth_font* fnt, unsigned int codepoint, short isize)
+{
+	int i = fnt->lut[hashint(codepoint) & (HASH_LUT_SIZE-1)];
 	while (i != -1)
 	{
 		if (fnt->glyphs[i].codepoint == codepoint && fnt->glyphs[i].size == isize)
 			return &fnt->glyphs[i];
 		i = fnt->glyphs[i].next;
 	}
+	return 0;
+}
 
-	// Could not find glyph, create it.
-	scale = stbtt_ScaleForPixelHeight(&fnt->font, size);
-	g = stbtt_FindGlyphIndex(&fnt->font, (int)codepoint);
-	stbtt_GetGlyphHMetrics(&fnt->font, g, &advance, &lsb);
-	stbtt_GetGlyphBitmapBox(&fnt->font, g, scale,scale, &x0,&y0,&x1,&y1);
-	gw = x1-x0;
-	gh = y1-y0;
-
+// Finds room for a w*h rectangle in the texture.
+static int alloc_rect(struct sth_stash* stash, int w, int h, int* x, int* y)
+{
+	int i, rh;
+	struct sth_row* br;
 
 	// Find row where the glyph can be fit.
 	br = NULL;
-	rh = (gh+7) & ~7;
+	rh = (h+7) & ~7;
 	for (i = 0; i < stash->nrows; ++i)
 	{
-		if (stash->rows[i].h == rh && stash->rows[i].x+gw+1 <= stash->tw)
+		if (stash->rows[i].h == rh && stash->rows[i].x+w+1 <= stash->tw)
 			br = &stash->rows[i];
 	}
 
@@ -250,6 +1055,69 @@ static struct sth_glyph* get_glyph(struct sth_stash* stash, struct sth_font* fnt
 		stash->nrows++;
 	}
 
+	*x = br->x;
+	*y = br->y;
+
+	// Advance row location.
+	br->x += w+1;
+
+	return 1;
+}
+
+struct sth_tiler
+{
+	struct sth_stash* stash;
+	struct sth_font* fnt;
+	int ok;
+};
+
+// Stores one non-empty tile of a large glyph in the texture.
+static void add_tile(void* ctx, int x, int y, int w, int h, const unsigned char* pixels, int stride)
+{
+	struct sth_tiler* tiler = (struct sth_tiler*)ctx;
+	struct sth_font* fnt = tiler->fnt;
+	struct sth_tile* tile;
+	int tx, ty;
+
+	if (!tiler->ok) return;
+	if (!alloc_rect(tiler->stash, w, h, &tx, &ty))
+	{
+		tiler->ok = 0;
+		return;
+	}
+	if (fnt->ntiles == fnt->ctiles)
+	{
+		int n = fnt->ctiles ? fnt->ctiles*2 : 64;
+		tile = (struct sth_tile*)realloc(fnt->tiles, (unsigned)n*sizeof(struct sth_tile));
+		if (!tile)
+		{
+			tiler->ok = 0;
+			return;
+		}
+		fnt->tiles = tile;
+		fnt->ctiles = n;
+	}
+
+	tile = &fnt->tiles[fnt->ntiles++];
+	tile->x = (short)x;
+	tile->y = (short)y;
+	tile->x0 = tx;
+	tile->y0 = ty;
+	tile->x1 = tx+w;
+	tile->y1 = ty+h;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,stride);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, tx,ty, w,h, GL_ALPHA,GL_UNSIGNED_BYTE,pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+}
+
+// Appends an empty glyph for the code point and size to the font's cache.
+static struct sth_glyph* new_glyph(struct sth_font* fnt, unsigned int codepoint, short isize)
+{
+	struct sth_glyph* glyph;
+	unsigned int h;
+
 	// Alloc space for new glyph.
 	fnt->nglyphs++;
 	fnt->glyphs = (struct sth_glyph*)realloc(fnt->glyphs, (unsigned)fnt->nglyphs*sizeof(struct sth_glyph));
@@ -260,37 +1128,439 @@ static struct sth_glyph* get_glyph(struct sth_stash* stash, struct sth_font* fnt
 	memset(glyph, 0, sizeof(struct sth_glyph));
 	glyph->codepoint = codepoint;
 	glyph->size = isize;
-	glyph->x0 = br->x;
-	glyph->y0 = br->y;
+	glyph->tile = -1;
+
+	// Insert char to hash lookup.
+	h = hashint(codepoint) & (HASH_LUT_SIZE-1);
+	glyph->next = fnt->lut[h];
+	fnt->lut[h] = fnt->nglyphs-1;
+
+	return glyph;
+}
+
+// Adds a glyph for the code point and size, and reserves its place in the
+// texture. Fills in 'job' with what is needed to rasterize it. Glyphs larger
+// than TILED_GLYPH_SIZE are rasterized here instead, in tiles, and only the
+// tiles with coverage are stored; their job is left empty.
+static struct sth_glyph* add_glyph(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, short isize,
+								   stbtt_glyphjob* job)
+{
+	int g,advance,lsb,x0,y0,x1,y1,gw,gh,gx,gy,tiled;
+	float scale;
+	struct sth_glyph* glyph;
+	float size = isize/10.0f;
+
+	scale = stbtt_ScaleForPixelHeight(&fnt->font, size);
+	g = stbtt_FindGlyphIndex(&fnt->font, (int)codepoint);
+	stbtt_GetGlyphHMetrics(&fnt->font, g, &advance, &lsb);
+	stbtt_GetGlyphBitmapBox(&fnt->font, g, scale,scale, &x0,&y0,&x1,&y1);
+	gw = x1-x0;
+	gh = y1-y0;
+
+	tiled = gw > TILED_GLYPH_SIZE || gh > TILED_GLYPH_SIZE;
+	gx = gy = 0;
+	if (!tiled && !alloc_rect(stash, gw, gh, &gx, &gy))
+		return 0;
+
+	glyph = new_glyph(fnt, codepoint, isize);
+	if (!glyph) return 0;
+	glyph->x0 = gx;
+	glyph->y0 = gy;
 	glyph->x1 = glyph->x0+gw;
 	glyph->y1 = glyph->y0+gh;
 	glyph->xadv = scale * advance;
 	glyph->xoff = (float)x0;
 	glyph->yoff = (float)y0;
-	glyph->next = 0;
 
-	// Advance row location.
-	br->x += gw+1;
+	memset(job, 0, sizeof(stbtt_glyphjob));
+	job->glyph = g;
+	job->scale_x = job->scale_y = scale;
 
-	// Insert char to hash lookup.
-	glyph->next = fnt->lut[h];
-	fnt->lut[h] = fnt->nglyphs-1;
+	if (tiled)
+	{
+		struct sth_tiler tiler;
+		struct sth_row rows[MAX_ROWS];
+		stbtt_vertex* verts;
+		int nverts, nrows;
+		// Tiles only ever take space at the ends of rows, so the rows as
+		// they are now are enough to give it all back.
+		nrows = stash->nrows;
+		memcpy(rows, stash->rows, (size_t)nrows*sizeof(struct sth_row));
+		tiler.stash = stash;
+		tiler.fnt = fnt;
+		tiler.ok = 1;
+		glyph->tile = fnt->ntiles;
+		verts = get_outline(stash, fnt, g, &nverts);
+		stbtt_RasterizeTiled(gw, gh, TILE_SIZE, 1, 0.35f, verts, nverts, scale, scale, x0, y0, 1,
+							 add_tile, &tiler, fnt->font.userdata);
+		if (!tiler.ok)
+		{
+			// Out of space; drop the glyph so it is tried again later, and
+			// free the texture space of the tiles that did fit.
+			fnt->lut[hashint(codepoint) & (HASH_LUT_SIZE-1)] = glyph->next;
+			fnt->ntiles = glyph->tile;
+			fnt->nglyphs--;
+			memcpy(stash->rows, rows, (size_t)nrows*sizeof(struct sth_row));
+			stash->nrows = nrows;
+			return 0;
+		}
+		glyph->ntiles = fnt->ntiles - glyph->tile;
+		return glyph;
+	}
+
+	job->w = gw;
+	job->h = gh;
+
+	return glyph;
+}
+
+static struct sth_glyph* get_glyph(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, short isize)
+{
+	struct sth_glyph* glyph;
+	stbtt_glyphjob job;
+	unsigned char* bmp;
+
+	// Find code point and size.
+	glyph = find_glyph(fnt, codepoint, isize);
+	if (glyph) return glyph;
 
-	// Rasterize
-	bmp = (unsigned char*)malloc(size_t(gw*gh));
+	// Could not find glyph, create it.
+	glyph = add_glyph(stash, fnt, codepoint, isize, &job);
+	if (!glyph) return 0;
+
+	// Rasterize, unless it was done in tiles already.
+	if (glyph->tile != -1)
+		bmp = NULL;
+	else
+		bmp = (unsigned char*)stbtt_ArenaAlloc(&stash->scratch, size_t(job.w*job.h));
 	if (bmp)
 	{
-		stbtt_MakeGlyphBitmap(&fnt->font, bmp, gw,gh,gw, scale,scale, g);
+		job.vertices = get_outline(stash, fnt, job.glyph, &job.num_verts);
+		stbtt_MakeGlyphBitmapFromShape(&fnt->font, bmp, job.w,job.h,job.w, job.scale_x,job.scale_y, job.glyph,
+									   job.vertices, job.num_verts);
 		// Update texture
 		glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, glyph->x0,glyph->y0, gw,gh, GL_ALPHA,GL_UNSIGNED_BYTE,bmp);
-		free(bmp);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, glyph->x0,glyph->y0, job.w,job.h, GL_ALPHA,GL_UNSIGNED_BYTE,bmp);
 	}
+	stbtt_ArenaReset(&stash->scratch);
 
 	return glyph;
 }
 
-static int get_quad(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, short isize, float* x, float* y, struct sth_quad* q)
+// Whether text at 'size' is drawn, and so measured and prewarmed, from
+// meshes. That needs the block of solid texels; when the atlas has no room
+// for it the text stays on bitmap glyphs, in all three places alike.
+static int get_white(struct sth_stash* stash);
+
+static int is_vector(struct sth_stash* stash, float size)
+{
+	return stash->vector_size > 0 && size >= stash->vector_size && get_white(stash);
+}
+
+// Returns the mesh of the code point for drawing at 'size', making it if
+// needed. One mesh is kept per code point for each doubling of size above
+// the vector size.
+static struct sth_mesh* get_mesh(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, float size)
+{
+	float top = stash->vector_size*2;
+	float* tris;
+	stbtt_vertex* verts;
+	struct sth_mesh* m;
+	unsigned int h;
+	int i, g, lsb, nverts, ntris;
+
+	while (top <= size)
+		top *= 2;
+
+	h = hashint(codepoint) & (HASH_LUT_SIZE-1);
+	for (i = fnt->mesh_lut[h]; i != -1; i = fnt->meshes[i].next)
+	{
+		if (fnt->meshes[i].codepoint == codepoint && fnt->meshes[i].size == top)
+			return &fnt->meshes[i];
+	}
+
+	if (fnt->nmeshes == fnt->cmeshes)
+	{
+		int n = fnt->cmeshes ? fnt->cmeshes*2 : 64;
+		m = (struct sth_mesh*)realloc(fnt->meshes, (unsigned)n*sizeof(struct sth_mesh));
+		if (!m) return 0;
+		fnt->meshes = m;
+		fnt->cmeshes = n;
+	}
+
+	m = &fnt->meshes[fnt->nmeshes];
+	g = stbtt_FindGlyphIndex(&fnt->font, (int)codepoint);
+	stbtt_GetGlyphHMetrics(&fnt->font, g, &m->advance, &lsb);
+	if (!stbtt_GetGlyphBox(&fnt->font, g, &m->x0,&m->y0,&m->x1,&m->y1))
+		m->x0 = m->y0 = m->x1 = m->y1 = 0;
+
+	// Triangulate within 0.35 pixels at the largest size the mesh is for.
+	verts = get_outline(stash, fnt, g, &nverts);
+	ntris = stbtt_TessellateShape(verts, nverts, 0.35f/stbtt_ScaleForPixelHeight(&fnt->font, top), &tris,
+								  fnt->font.userdata);
+	if (fnt->nmesh_verts + ntris*6 > fnt->cmesh_verts)
+	{
+		int n = fnt->cmesh_verts ? fnt->cmesh_verts : 4096;
+		float* v;
+		while (n < fnt->nmesh_verts + ntris*6)
+			n *= 2;
+		v = (float*)realloc(fnt->mesh_verts, (unsigned)n*sizeof(float));
+		if (!v)
+		{
+			stbtt_ArenaReset(&stash->scratch);
+			return 0;
+		}
+		fnt->mesh_verts = v;
+		fnt->cmesh_verts = n;
+	}
+	if (ntris)
+		memcpy(fnt->mesh_verts + fnt->nmesh_verts, tris, (unsigned)ntris*6*sizeof(float));
+	stbtt_ArenaReset(&stash->scratch);
+
+	m->codepoint = codepoint;
+	m->size = top;
+	m->first = fnt->nmesh_verts;
+	m->ntris = ntris;
+	m->next = fnt->mesh_lut[h];
+	fnt->mesh_lut[h] = fnt->nmeshes++;
+	fnt->nmesh_verts += ntris*6;
+
+	return m;
+}
+
+// Puts a block of solid texels in the texture for drawing meshes with, so
+// that they go in the same batch as the textured glyphs.
+static int get_white(struct sth_stash* stash)
+{
+	unsigned char block[4*4];
+	int x, y;
+	if (stash->has_white) return 1;
+	if (!alloc_rect(stash, 4, 4, &x, &y)) return 0;
+	memset(block, 0xff, sizeof(block));
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x,y, 4,4, GL_ALPHA,GL_UNSIGNED_BYTE,block);
+	stash->white_s = (x+2) * stash->itw;
+	stash->white_t = (y+2) * stash->ith;
+	stash->has_white = 1;
+	return 1;
+}
+
+int sth_prewarm(struct sth_stash* stash, int idx, float size, const char* s)
+{
+	unsigned int codepoint;
+	unsigned int state = 0;
+	short isize = (short)(size*10.0f);
+	struct sth_font* fnt;
+	struct sth_font* gfnt;
+	struct sth_glyph* glyph;
+	const char* str = s;
+	stbtt_glyphjob* jobs;
+	int* dst;
+	unsigned char* bmp;
+	int i, slot, njobs = 0, nglyphs = 0, maxjobs, stagew = 0, stageh = 0;
+
+	if (stash == NULL) return 0;
+	if (!stash->tex) return 0;
+	fnt = get_font(stash, idx);
+	if (!fnt) return 0;
+
+	// Text this large is drawn from meshes, not from the texture.
+	if (is_vector(stash, size))
+	{
+		for (; *s; ++s)
+		{
+			if (decutf8(&state, &codepoint, *(unsigned char*)s)) continue;
+			if (get_mesh(stash, resolve(stash, fnt, codepoint), codepoint, size)) ++nglyphs;
+		}
+		return nglyphs;
+	}
+
+	maxjobs = (int)strlen(s);
+	jobs = (stbtt_glyphjob*)stbtt_ArenaAlloc(&stash->scratch, (size_t)maxjobs*sizeof(stbtt_glyphjob));
+	dst = (int*)stbtt_ArenaAlloc(&stash->scratch, (size_t)maxjobs*2*sizeof(int));
+	if (!jobs || !dst) goto done;
+
+	// Place every glyph that is not cached yet. Glyphs from fallback fonts
+	// are left for later.
+	for (; *s; ++s)
+	{
+		if (decutf8(&state, &codepoint, *(unsigned char*)s)) continue;
+		if (resolve(stash, fnt, codepoint) != fnt) continue;
+		if (find_glyph(fnt, codepoint, isize)) continue;
+		glyph = add_glyph(stash, fnt, codepoint, isize, &jobs[njobs]);
+		if (!glyph) break;
+		++nglyphs;
+		if (!jobs[njobs].w || !jobs[njobs].h) continue;
+		dst[njobs*2+0] = glyph->x0;
+		dst[njobs*2+1] = glyph->y0;
+		if (jobs[njobs].w > stagew) stagew = jobs[njobs].w;
+		++njobs;
+	}
+	if (njobs == 0) goto done;
+
+	// Outlines are taken from the outline cache when there, and otherwise
+	// parsed by the workers. They are looked up only now, as placing a tiled
+	// glyph above may have evicted some from the cache.
+	for (i = 0; i < njobs; ++i)
+	{
+		slot = find_outline(fnt, jobs[i].glyph);
+		if (slot != -1)
+		{
+			jobs[i].vertices = fnt->outlines[slot].verts;
+			jobs[i].num_verts = fnt->outlines[slot].nverts;
+		}
+	}
+
+	// Stack the glyphs in a staging buffer, rasterize, and upload each from there.
+	for (i = 0; i < njobs; ++i)
+	{
+		jobs[i].y = stageh;
+		stageh += jobs[i].h;
+	}
+	bmp = (unsigned char*)stbtt_ArenaAlloc(&stash->scratch, (size_t)stagew*(size_t)stageh);
+	if (!bmp) goto done;
+	run_batch(stash->pool, &fnt->font, bmp, stagew, jobs, njobs);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,stagew);
+	for (i = 0; i < njobs; ++i)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, dst[i*2+0],dst[i*2+1], jobs[i].w,jobs[i].h, GL_ALPHA,GL_UNSIGNED_BYTE,
+						bmp + jobs[i].y*stagew);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+
+done:
+	stbtt_ArenaReset(&stash->scratch);
+
+	// The few glyphs that come from fallback fonts are rasterized one by one.
+	if (fnt->nfallbacks)
+	{
+		for (state = 0; *str; ++str)
+		{
+			if (decutf8(&state, &codepoint, *(unsigned char*)str)) continue;
+			gfnt = resolve(stash, fnt, codepoint);
+			if (gfnt == fnt || find_glyph(gfnt, codepoint, isize)) continue;
+			if (!get_glyph(stash, gfnt, codepoint, isize)) break;
+			++nglyphs;
+		}
+	}
+	return nglyphs;
+}
+
+// Baked atlases are written by tools/sthbake. All fields are little-endian:
+//   "STHB", u32 version, u16 width, u16 height, u16 nrows, u16 nfonts, u32 nglyphs
+//   nfonts * { u16 font, u16 numGlyphs, u32 checksum, u32 face offset }
+//   nrows * { u16 x, y, h }
+//   nglyphs * { u32 codepoint, u16 font, i16 size*10, u16 x0, y0, x1, y1, f32 xadv, xoff, yoff }
+//   width*height alpha texels
+// A font is identified by the checksum of its file from the 'head' table and
+// where its face starts in the file; glyphs are only taken over by a slot
+// holding the same face they were baked from.
+#define BAKED_VERSION 2
+#define BAKED_HEADER_SIZE 20
+#define BAKED_FONT_SIZE 12
+#define BAKED_ROW_SIZE 6
+#define BAKED_GLYPH_SIZE 28
+
+static unsigned int get16(const unsigned char* p)
+{
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static unsigned int get32(const unsigned char* p)
+{
+	return get16(p) | (get16(p+2) << 16);
+}
+
+static float getf32(const unsigned char* p)
+{
+	unsigned int u = get32(p);
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// Whether the slot holds the face described by the baked font record.
+static int baked_font_matches(struct sth_font* fnt, const unsigned char* p)
+{
+	if (!fnt || !fnt->font.head) return 0;
+	return get16(p+2) == (unsigned int)fnt->font.numGlyphs &&
+		get32(p+4) == ttULONG(fnt->font.data + fnt->font.head + 8) &&
+		get32(p+8) == (unsigned int)fnt->font.fontstart;
+}
+
+int sth_add_baked(struct sth_stash* stash, const unsigned char* data, int size)
+{
+	const unsigned char *p, *fonts;
+	struct sth_font* fnt;
+	struct sth_glyph* glyph;
+	unsigned int codepoint, slot;
+	int i, j, w, h, nfonts, nrows, nglyphs, added = 0;
+	short isize;
+
+	if (stash == NULL || data == NULL) return 0;
+	if (!stash->tex) return 0;
+	if (size < BAKED_HEADER_SIZE || memcmp(data, "STHB", 4) != 0 || get32(data+4) != BAKED_VERSION) return 0;
+	w = (int)get16(data+8);
+	h = (int)get16(data+10);
+	nrows = (int)get16(data+12);
+	nfonts = (int)get16(data+14);
+	nglyphs = (int)get32(data+16);
+	// The baked layout is taken over as is, so the texture must still be empty.
+	if (stash->nrows || w > stash->tw || h > stash->th) return 0;
+	if (nrows > MAX_ROWS || nglyphs > (size - BAKED_HEADER_SIZE) / BAKED_GLYPH_SIZE) return 0;
+	if (size != BAKED_HEADER_SIZE + nfonts*BAKED_FONT_SIZE + nrows*BAKED_ROW_SIZE + nglyphs*BAKED_GLYPH_SIZE + w*h) return 0;
+
+	// Every glyph must lie within the texels that come with it.
+	p = data + BAKED_HEADER_SIZE + nfonts*BAKED_FONT_SIZE + nrows*BAKED_ROW_SIZE;
+	for (i = 0; i < nglyphs; ++i, p += BAKED_GLYPH_SIZE)
+	{
+		if (get16(p+8) > get16(p+12) || (int)get16(p+12) > w) return 0;
+		if (get16(p+10) > get16(p+14) || (int)get16(p+14) > h) return 0;
+	}
+
+	fonts = data + BAKED_HEADER_SIZE;
+	p = fonts + nfonts*BAKED_FONT_SIZE;
+	for (i = 0; i < nrows; ++i, p += BAKED_ROW_SIZE)
+	{
+		stash->rows[i].x = (short)get16(p);
+		stash->rows[i].y = (short)get16(p+2);
+		stash->rows[i].h = (short)get16(p+4);
+	}
+	stash->nrows = nrows;
+
+	// Glyphs of fonts that are not loaded, are loaded from another face, or
+	// are already cached, are skipped; their texels stay unused.
+	for (i = 0; i < nglyphs; ++i, p += BAKED_GLYPH_SIZE)
+	{
+		codepoint = get32(p);
+		slot = get16(p+4);
+		isize = (short)get16(p+6);
+		for (j = 0; j < nfonts && get16(fonts + j*BAKED_FONT_SIZE) != slot; ++j) {}
+		if (j == nfonts) continue;
+		fnt = get_font(stash, (int)slot);
+		if (!baked_font_matches(fnt, fonts + j*BAKED_FONT_SIZE) || find_glyph(fnt, codepoint, isize)) continue;
+		glyph = new_glyph(fnt, codepoint, isize);
+		if (!glyph) break;
+		glyph->x0 = (int)get16(p+8);
+		glyph->y0 = (int)get16(p+10);
+		glyph->x1 = (int)get16(p+12);
+		glyph->y1 = (int)get16(p+14);
+		glyph->xadv = getf32(p+16);
+		glyph->xoff = getf32(p+20);
+		glyph->yoff = getf32(p+24);
+		++added;
+	}
+
+	if (w && h)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0, w,h, GL_ALPHA,GL_UNSIGNED_BYTE, data + size - w*h);
+	}
+
+	return added;
+}
+
+static struct sth_glyph* get_quad(struct sth_stash* stash, struct sth_font* fnt, unsigned int codepoint, short isize, float* x, float* y, struct sth_quad* q)
 {
 	int rx,ry;
 	struct sth_glyph* glyph = get_glyph(stash, fnt, codepoint, isize);
@@ -311,7 +1581,7 @@ static int get_quad(struct sth_stash* stash, struct sth_font* fnt, unsigned int
 
 	*x += glyph->xadv;
 
-	return 1;
+	return glyph;
 }
 
 static float* setv(float* v, float x, float y, float s, float t, unsigned colour)
@@ -327,6 +1597,71 @@ static float* setv(float* v, float x, float y, float s, float t, unsigned colour
 	return v+VERT_SIZE;
 }
 
+static void flush_draw(struct sth_stash* stash);
+
+static void add_quad(struct sth_stash* stash, const struct sth_quad* q, unsigned colour)
+{
+	float* v;
+
+	if (stash->nverts+6 >= VERT_COUNT)
+		flush_draw(stash);
+
+	v = &stash->verts[stash->nverts*VERT_SIZE];
+
+	v = setv(v, q->x0, q->y0, q->s0, q->t0, colour);
+	v = setv(v, q->x1, q->y0, q->s1, q->t0, colour);
+	v = setv(v, q->x1, q->y1, q->s1, q->t1, colour);
+
+	v = setv(v, q->x0, q->y0, q->s0, q->t0, colour);
+	v = setv(v, q->x1, q->y1, q->s1, q->t1, colour);
+	v = setv(v, q->x0, q->y1, q->s0, q->t1, colour);
+
+	stash->nverts += 6;
+}
+
+// Draws a mesh with its origin at x,y, 'scale' pixels per font unit.
+static void add_mesh(struct sth_stash* stash, struct sth_font* fnt, const struct sth_mesh* m, float x, float y,
+					 float scale, unsigned colour)
+{
+	const float* p = fnt->mesh_verts + m->first;
+	float* v;
+	int i;
+
+	for (i = 0; i < m->ntris; ++i, p += 6)
+	{
+		if (stash->nverts+3 >= VERT_COUNT)
+			flush_draw(stash);
+		v = &stash->verts[stash->nverts*VERT_SIZE];
+		v = setv(v, x + p[0]*scale, y + p[1]*scale, stash->white_s, stash->white_t, colour);
+		v = setv(v, x + p[2]*scale, y + p[3]*scale, stash->white_s, stash->white_t, colour);
+		v = setv(v, x + p[4]*scale, y + p[5]*scale, stash->white_s, stash->white_t, colour);
+		stash->nverts += 3;
+	}
+}
+
+// Draws a tiled glyph whose whole box on screen is 'q', one quad per tile.
+static void add_tiles(struct sth_stash* stash, struct sth_font* fnt, struct sth_glyph* glyph, const struct sth_quad* q,
+					  unsigned colour)
+{
+	struct sth_quad tq;
+	struct sth_tile* tile;
+	int i;
+
+	for (i = 0; i < glyph->ntiles; ++i)
+	{
+		tile = &fnt->tiles[glyph->tile+i];
+		tq.x0 = q->x0 + tile->x;
+		tq.y0 = q->y0 - tile->y;
+		tq.x1 = tq.x0 + (tile->x1 - tile->x0);
+		tq.y1 = tq.y0 - (tile->y1 - tile->y0);
+		tq.s0 = tile->x0 * stash->itw;
+		tq.t0 = tile->y0 * stash->ith;
+		tq.s1 = tile->x1 * stash->itw;
+		tq.t1 = tile->y1 * stash->ith;
+		add_quad(stash, &tq, colour);
+	}
+}
+
 static void flush_draw(struct sth_stash* stash)
 {
 	if (stash->nverts == 0)
@@ -374,35 +1709,42 @@ void sth_draw_text(struct sth_stash* stash,
 	unsigned int state = 0;
 	struct sth_quad q;
 	short isize = (short)(size*10.0f);
-	float* v;
 	struct sth_font* fnt;
+	struct sth_font* gfnt;
+	struct sth_glyph* glyph;
+	struct sth_mesh* mesh;
+	float scale;
+	int vector;
 
 	if (stash == NULL) return;
 	if (!stash->tex) return;
-	if (idx < 0 || idx >= MAX_FONTS) return;
-	fnt = &stash->fonts[idx];
-	if (!fnt->data) return;
+	fnt = get_font(stash, idx);
+	if (!fnt) return;
+
+	vector = is_vector(stash, size);
 
 	for (; *s; ++s)
 	{
 		if (decutf8(&state, &codepoint, *(unsigned char*)s)) continue;
+		gfnt = resolve(stash, fnt, codepoint);
 
-		if (stash->nverts+6 >= VERT_COUNT)
-			flush_draw(stash);
-
-		if (!get_quad(stash, fnt, codepoint, isize, &x, &y, &q)) continue;
-
-		v = &stash->verts[stash->nverts*VERT_SIZE];
-
-		v = setv(v, q.x0, q.y0, q.s0, q.t0, colour);
-		v = setv(v, q.x1, q.y0, q.s1, q.t0, colour);
-		v = setv(v, q.x1, q.y1, q.s1, q.t1, colour);
+		if (vector)
+		{
+			mesh = get_mesh(stash, gfnt, codepoint, size);
+			if (!mesh) continue;
+			scale = stbtt_ScaleForPixelHeight(&gfnt->font, size);
+			add_mesh(stash, gfnt, mesh, x, y, scale, colour);
+			x += mesh->advance*scale;
+			continue;
+		}
 
-		v = setv(v, q.x0, q.y0, q.s0, q.t0, colour);
-		v = setv(v, q.x1, q.y1, q.s1, q.t1, colour);
-		v = setv(v, q.x0, q.y1, q.s0, q.t1, colour);
+		glyph = get_quad(stash, gfnt, codepoint, isize, &x, &y, &q);
+		if (!glyph) continue;
 
-		stash->nverts += 6;
+		if (glyph->tile != -1)
+			add_tiles(stash, gfnt, glyph, &q, colour);
+		else
+			add_quad(stash, &q, colour);
 	}
 
 	if (dx) *dx = x;
@@ -418,21 +1760,37 @@ void sth_dim_text(struct sth_stash* stash,
 	struct sth_quad q;
 	short isize = (short)(size*10.0f);
 	struct sth_font* fnt;
-	float x = 0, y = 0;
+	struct sth_font* gfnt;
+	struct sth_mesh* mesh;
+	float x = 0, y = 0, scale;
+	int vector;
  
 	if (stash == NULL) return;
 	if (!stash->tex) return;
-	if (idx < 0 || idx >= MAX_FONTS) return;
-	fnt = &stash->fonts[idx];
-	if (!fnt->data) return;
+	fnt = get_font(stash, idx);
+	if (!fnt) return;
 
 	*minx = *maxx = x;
 	*miny = *maxy = y;
 
+	vector = is_vector(stash, size);
+
 	for (; *s; ++s)
 	{
 		if (decutf8(&state, &codepoint, *(unsigned char*)s)) continue;
-		if (!get_quad(stash, fnt, codepoint, isize, &x, &y, &q)) continue;
+		gfnt = resolve(stash, fnt, codepoint);
+		if (vector)
+		{
+			mesh = get_mesh(stash, gfnt, codepoint, size);
+			if (!mesh) continue;
+			scale = stbtt_ScaleForPixelHeight(&gfnt->font, size);
+			q.x0 = x + mesh->x0*scale;
+			q.y0 = y + mesh->y1*scale;
+			q.x1 = x + mesh->x1*scale;
+			q.y1 = y + mesh->y0*scale;
+			x += mesh->advance*scale;
+		}
+		else if (!get_quad(stash, gfnt, codepoint, isize, &x, &y, &q)) continue;
 		if (q.x0 < *minx) *minx = q.x0;
 		if (q.x1 > *maxx) *maxx = q.x1;
 		if (q.y1 < *miny) *miny = q.y1;
@@ -444,16 +1802,17 @@ void sth_vmetrics(struct sth_stash* stash,
 				  int idx, float size,
 				  float* ascender, float* descender, float* lineh)
 {
+	struct sth_font* fnt;
 	if (stash == NULL) return;
 	if (!stash->tex) return;
-	if (idx < 0 || idx >= MAX_FONTS) return;
-	if (!stash->fonts[idx].data) return;
+	fnt = get_font(stash, idx);
+	if (!fnt) return;
 	if (ascender)
-		*ascender = stash->fonts[idx].ascender*size;
+		*ascender = fnt->ascender*size;
 	if (descender)
-		*descender = stash->fonts[idx].descender*size;
+		*descender = fnt->descender*size;
 	if (lineh)
-		*lineh = stash->fonts[idx].lineh*size;
+		*lineh = fnt->lineh*size;
 }
 
 void sth_delete(struct sth_stash* stash)
@@ -461,12 +1820,10 @@ void sth_delete(struct sth_stash* stash)
 	int i;
 	if (!stash) return;
 	if (stash->tex) glDeleteTextures(1,&stash->tex);
-	for (i = 0; i < MAX_FONTS; ++i)
-	{
-		if (stash->fonts[i].glyphs)
-			free(stash->fonts[i].glyphs);
-		if (stash->fonts[i].data)
-			free(stash->fonts[i].data);
-	}
+	for (i = 0; i < stash->nfonts; ++i)
+		clear_font(stash, i);
+	free(stash->fonts);
+	delete_pool(stash->pool);
+	stbtt_ArenaRelease(&stash->scratch);
 	free(stash);
 }
@@ -22,6 +22,24 @@
 struct sth_stash* sth_create(int cachew, int cacheh);
 
 int sth_add_font(struct sth_stash*, int idx, const char* path);
+int sth_add_font_face(struct sth_stash* stash, int idx, const char* path, int face);
+
+int sth_add_font_async(struct sth_stash* stash, int idx, const char* path);
+int sth_add_font_face_async(struct sth_stash* stash, int idx, const char* path, int face);
+int sth_font_ready(struct sth_stash* stash, int idx);
+
+int sth_add_fallback(struct sth_stash* stash, int idx, int fallback);
+void sth_reset_fallbacks(struct sth_stash* stash, int idx);
+
+void sth_set_outline_cache(struct sth_stash* stash, int bytes);
+
+void sth_set_vector_size(struct sth_stash* stash, float size);
+
+void sth_set_threads(struct sth_stash* stash, int count);
+
+int sth_prewarm(struct sth_stash* stash, int idx, float size, const char* string);
+
+int sth_add_baked(struct sth_stash* stash, const unsigned char* data, int size);
 
 void sth_begin_draw(struct sth_stash* stash);
 void sth_end_draw(struct sth_stash* stash);
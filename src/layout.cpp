@@ -0,0 +1,166 @@
+#include "layout.h"
+
+// The batch kernel is SSE2 or NEON when the target guarantees them, and
+// plain C otherwise. #define LAYOUT_NO_SIMD to always use the C version.
+#ifndef LAYOUT_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAYOUT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define LAYOUT_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+static void solveAxis(Layout::Axis& a, int const* parent, int begin, int end) {
+  float* pos = a.pos.data();
+  float* size = a.size.data();
+  int i = begin;
+#if defined(LAYOUT_SSE2) || defined(LAYOUT_NEON)
+  for (; i + 4 <= end; i += 4) {
+    int const* p = parent + i;
+    float pp[4] = {pos[p[0]], pos[p[1]], pos[p[2]], pos[p[3]]};
+    float ps[4] = {size[p[0]], size[p[1]], size[p[2]], size[p[3]]};
+#ifdef LAYOUT_SSE2
+    __m128 vpp = _mm_loadu_ps(pp);
+    __m128 vps = _mm_loadu_ps(ps);
+    __m128 vpos = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&a.origin[static_cast<size_t>(i)]), vpp),
+                                        _mm_mul_ps(_mm_loadu_ps(&a.posScale[static_cast<size_t>(i)]), vps)),
+                             _mm_loadu_ps(&a.posBase[static_cast<size_t>(i)]));
+    __m128 vsize = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&a.sizeScale[static_cast<size_t>(i)]), vps),
+                              _mm_loadu_ps(&a.sizeBase[static_cast<size_t>(i)]));
+    _mm_storeu_ps(pos + i, vpos);
+    _mm_storeu_ps(size + i, vsize);
+#else
+    float32x4_t vpp = vld1q_f32(pp);
+    float32x4_t vps = vld1q_f32(ps);
+    float32x4_t vpos = vaddq_f32(vaddq_f32(vmulq_f32(vld1q_f32(&a.origin[static_cast<size_t>(i)]), vpp),
+                                           vmulq_f32(vld1q_f32(&a.posScale[static_cast<size_t>(i)]), vps)),
+                                 vld1q_f32(&a.posBase[static_cast<size_t>(i)]));
+    float32x4_t vsize = vaddq_f32(vmulq_f32(vld1q_f32(&a.sizeScale[static_cast<size_t>(i)]), vps),
+                                  vld1q_f32(&a.sizeBase[static_cast<size_t>(i)]));
+    vst1q_f32(pos + i, vpos);
+    vst1q_f32(size + i, vsize);
+#endif
+  }
+#endif
+  for (; i < end; ++i) {
+    size_t n = static_cast<size_t>(i);
+    float pp = pos[parent[i]];
+    float ps = size[parent[i]];
+    pos[n] = a.origin[n]*pp + a.posScale[n]*ps + a.posBase[n];
+    size[n] = a.sizeScale[n]*ps + a.sizeBase[n];
+  }
+}
+
+static void pushPos(Layout::Axis& a, Shape const& s) {
+  switch (s.kind) {
+  case Shape::Fixed: a.origin.push_back(0.0f); a.posScale.push_back(0.0f); a.posBase.push_back(s.a); break;
+  case Shape::Offset: a.origin.push_back(1.0f); a.posScale.push_back(0.0f); a.posBase.push_back(s.a); break;
+  case Shape::Fraction: a.origin.push_back(1.0f); a.posScale.push_back(s.a); a.posBase.push_back(s.b); break;
+  case Shape::Custom: a.origin.push_back(0.0f); a.posScale.push_back(0.0f); a.posBase.push_back(0.0f); break;
+  }
+  a.pos.push_back(0.0f);
+}
+
+static void pushSize(Layout::Axis& a, Shape const& s) {
+  switch (s.kind) {
+  case Shape::Fixed: a.sizeScale.push_back(0.0f); a.sizeBase.push_back(s.a); break;
+  case Shape::Offset: a.sizeScale.push_back(1.0f); a.sizeBase.push_back(s.a); break;
+  case Shape::Fraction: a.sizeScale.push_back(s.a); a.sizeBase.push_back(s.b); break;
+  case Shape::Custom: a.sizeScale.push_back(0.0f); a.sizeBase.push_back(0.0f); break;
+  }
+  a.size.push_back(0.0f);
+}
+
+Layout::Layout(float l, float t, float w, float h) {
+  add(0, fixed(l), fixed(t), fixed(w), fixed(h));
+}
+
+int Layout::add(int parent_, Shape const& l, Shape const& t, Shape const& w, Shape const& h) {
+  int node = static_cast<int>(parent.size());
+  assert(node == 0 ? parent_ == 0 : parent_ >= 0 && parent_ < node);
+  parent.push_back(parent_);
+  pushPos(x, l);
+  pushPos(y, t);
+  pushSize(x, w);
+  pushSize(y, h);
+  Shape const* shapes[4] = {&l, &t, &w, &h};
+  for (int field = 0; field < 4; ++field) {
+    if (shapes[field]->kind == Shape::Custom)
+      customs.push_back(CustomField{node, field, shapes[field]->custom});
+  }
+  batched = false;
+  return node;
+}
+
+void Layout::setRoot(float l, float t, float w, float h) {
+  x.posBase[0] = l;
+  y.posBase[0] = t;
+  x.sizeBase[0] = w;
+  y.sizeBase[0] = h;
+}
+
+// Splits the nodes into runs whose parents all come before the run.
+static void findBatches(std::vector<int> const& parent, std::vector<int>& batches) {
+  batches.clear();
+  batches.push_back(0);
+  batches.push_back(1); // the root is its own parent
+  int begin = 1;
+  for (int i = 1; i < static_cast<int>(parent.size()); ++i) {
+    if (parent[static_cast<size_t>(i)] >= begin) {
+      batches.push_back(i);
+      begin = i;
+    }
+  }
+  if (batches.back() != static_cast<int>(parent.size()))
+    batches.push_back(static_cast<int>(parent.size()));
+}
+
+void Layout::solve() {
+  if (!batched) {
+    findBatches(parent, batches);
+    batched = true;
+  }
+  // The root's fields are its bases.
+  x.pos[0] = x.posBase[0];
+  y.pos[0] = y.posBase[0];
+  x.size[0] = x.sizeBase[0];
+  y.size[0] = y.sizeBase[0];
+  size_t next = 0;
+  for (size_t b = 1; b + 1 < batches.size(); ++b) {
+    int begin = batches[b], end = batches[b + 1];
+    solveAxis(x, parent.data(), begin, end);
+    solveAxis(y, parent.data(), begin, end);
+    for (; next < customs.size() && customs[next].node < end; ++next) {
+      CustomField const& c = customs[next];
+      size_t n = static_cast<size_t>(c.node);
+      float v = evalSync(c.get);
+      switch (c.field) {
+      case 0: x.pos[n] = v; break;
+      case 1: y.pos[n] = v; break;
+      case 2: x.size[n] = v; break;
+      default: y.size[n] = v; break;
+      }
+    }
+  }
+}
+
+struct LayoutField {
+  Layout const* layout;
+  int node;
+  int field;
+  template <typename K> void operator()(K const& k) const {
+    switch (field) {
+    case 0: k(layout->l(node)); break;
+    case 1: k(layout->t(node)); break;
+    case 2: k(layout->w(node)); break;
+    default: k(layout->h(node)); break;
+    }
+  }
+};
+
+Rect_ Layout::rect(int id) const {
+  return Rect_{node<float>(LayoutField{this, id, 0}), node<float>(LayoutField{this, id, 1}),
+               node<float>(LayoutField{this, id, 2}), node<float>(LayoutField{this, id, 3})};
+}
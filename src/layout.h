@@ -0,0 +1,117 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "ex.h"
+#include "track.h"
+
+#include <vector>
+
+struct Rect_ {
+  Val<Float> l;
+  Val<Float> t;
+  Val<Float> w;
+  Val<Float> h;
+};
+using Rect = Ex<Rect_>;
+
+inline Rect fixedRect(Float l, Float t, Float w, Float h) {
+  return lit(Rect_{l, t, w, h});
+}
+
+// A rectangle known at compile time.
+struct ConstRect {
+  float l, t, w, h;
+};
+
+struct FixedRect {
+  ConstRect r;
+  template <typename K> void operator()(K const& k) const { k(Rect_{lit(r.l), lit(r.t), lit(r.w), lit(r.h)}); }
+};
+
+// From literals, or arithmetic on them, the rectangle is itself a constant:
+// its fields are computed by the compiler and Rect_ getters only made for
+// whoever evaluates it.
+constexpr Node<Rect_, FixedRect> fixedRect(Node<float, Lit<float>> const& l, Node<float, Lit<float>> const& t,
+                                           Node<float, Lit<float>> const& w, Node<float, Lit<float>> const& h) {
+  return Node<Rect_, FixedRect>{FixedRect{ConstRect{constValue(l), constValue(t), constValue(w), constValue(h)}}};
+}
+
+template <> struct IsConst<Node<Rect_, FixedRect>>: std::true_type {};
+
+constexpr ConstRect constValue(Node<Rect_, FixedRect> const& e) {
+  return e.body.r;
+}
+
+// How one field of a laid out rectangle follows the same field of its parent.
+// Positions are absolute, so for them offset and fraction also start from
+// the parent's position; fraction always scales the parent's size.
+struct Shape {
+  enum Kind {Fixed, Offset, Fraction, Custom};
+  Kind kind;
+  float a, b;
+  Float custom;
+};
+
+// Always v.
+inline Shape fixed(float v) {
+  return Shape{Shape::Fixed, v, 0.0f, lit(0.0f)};
+}
+
+// The parent's field plus d.
+inline Shape offset(float d) {
+  return Shape{Shape::Offset, d, 0.0f, lit(0.0f)};
+}
+
+// f of the parent's size, plus d.
+inline Shape fraction(float f, float d = 0.0f) {
+  return Shape{Shape::Fraction, f, d, lit(0.0f)};
+}
+
+// Anything else, evaluated on its own after the rest of its batch.
+inline Shape custom(Float e) {
+  return Shape{Shape::Custom, 0.0f, 0.0f, e};
+}
+
+// Rectangles stored field by field in arrays indexed by node id. Every field
+// is an affine function of the parent's fields,
+//   pos  = origin*parent.pos + posScale*parent.size + posBase
+//   size = sizeScale*parent.size + sizeBase
+// so a run of nodes whose parents are all laid out already is solved as one
+// batch, several nodes at a time. Children added together after their parent
+// form such runs. Node 0 is the root.
+struct Layout {
+  struct Axis {
+    std::vector<float> pos, size;
+    std::vector<float> origin, posScale, posBase;
+    std::vector<float> sizeScale, sizeBase;
+  };
+  struct CustomField {
+    int node;
+    int field; // 0..3 for l, t, w, h
+    Float get;
+  };
+  Axis x, y;
+  std::vector<int> parent;
+  std::vector<CustomField> customs;
+  std::vector<int> batches; // start of each batch, then the end of the last
+  bool batched = false;
+
+  Layout(float l, float t, float w, float h);
+  explicit Layout(ConstRect r): Layout(r.l, r.t, r.w, r.h) {}
+
+  // Adds a node under parent, which must already be in the store, and
+  // returns its id. Only the root, added by the constructor, is its own parent.
+  int add(int parent, Shape const& l, Shape const& t, Shape const& w, Shape const& h);
+  void setRoot(float l, float t, float w, float h);
+  void setRoot(ConstRect r) { setRoot(r.l, r.t, r.w, r.h); }
+  void solve();
+
+  float l(int node) const { return x.pos[static_cast<size_t>(node)]; }
+  float t(int node) const { return y.pos[static_cast<size_t>(node)]; }
+  float w(int node) const { return x.size[static_cast<size_t>(node)]; }
+  float h(int node) const { return y.size[static_cast<size_t>(node)]; }
+  // Getters for the node's fields as last solved.
+  Rect_ rect(int id) const;
+};
+
+#endif // LAYOUT_H
@@ -0,0 +1,184 @@
+#include "loop.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+
+std::uint64_t nowMs() {
+  using namespace std::chrono;
+  return static_cast<std::uint64_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+Loop& currentLoop() {
+  static thread_local Loop loop;
+  return loop;
+}
+
+void waitForEvents() {
+  currentLoop().wait();
+}
+
+Loop::Loop(): tick(nowMs()), ntimers(0), pollFd(-1) {
+#ifdef __linux__
+  pollFd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd[0] = wakeFd[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeFd[0];
+  epoll_ctl(pollFd, EPOLL_CTL_ADD, wakeFd[0], &ev);
+#else
+  if (pipe(wakeFd) == 0) {
+    fcntl(wakeFd[0], F_SETFL, fcntl(wakeFd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFd[1], F_SETFL, fcntl(wakeFd[1], F_GETFL) | O_NONBLOCK);
+  }
+#endif
+  assert(wakeFd[0] >= 0);
+}
+
+Loop::~Loop() {
+#ifdef __linux__
+  close(pollFd);
+  close(wakeFd[0]);
+#else
+  close(wakeFd[0]);
+  close(wakeFd[1]);
+#endif
+}
+
+void Loop::addTimer(int ms, F<void ()> fn) {
+  std::uint64_t due = nowMs() + static_cast<std::uint64_t>(ms > 0 ? ms : 0);
+  // Ticks up to 'tick' have been swept already.
+  if (due <= tick) due = tick + 1;
+  wheel[due % wheelSize].push_back(Timer{due, std::move(fn)});
+  ++ntimers;
+}
+
+void Loop::addReader(int fd, F<void ()> fn) {
+  assert(readers.find(fd) == readers.end());
+  readers[fd] = std::move(fn);
+#ifdef __linux__
+  epoll_event ev = {};
+  ev.events = EPOLLIN | EPOLLONESHOT;
+  ev.data.fd = fd;
+  epoll_ctl(pollFd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+}
+
+void Loop::post(F<void ()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    posted.push_back(std::move(fn));
+  }
+#ifdef __linux__
+  std::uint64_t one = 1;
+  ssize_t n = write(wakeFd[1], &one, sizeof(one));
+#else
+  char one = 1;
+  ssize_t n = write(wakeFd[1], &one, 1);
+#endif
+  (void)n; // A full pipe or counter is already a pending wake-up.
+}
+
+// Milliseconds until the next timer is due, or -1 if there is none. Only one
+// turn of the wheel is looked at; timers further out are reached by waking
+// at the end of it.
+int Loop::timeout() const {
+  if (ntimers == 0) return -1;
+  std::uint64_t now = nowMs();
+  for (std::uint64_t t = tick + 1; t <= tick + wheelSize; ++t) {
+    for (Timer const& timer: wheel[t % wheelSize]) {
+      if (timer.due == t)
+        return t > now ? static_cast<int>(t - now) : 0;
+    }
+  }
+  std::uint64_t end = tick + wheelSize;
+  return end > now ? static_cast<int>(end - now) : 0;
+}
+
+void Loop::expire(std::uint64_t now) {
+  if (now <= tick) return;
+  std::vector<F<void ()>> due;
+  std::uint64_t last = now - tick > wheelSize ? tick + wheelSize : now;
+  for (std::uint64_t t = tick + 1; t <= last; ++t) {
+    std::vector<Timer>& slot = wheel[t % wheelSize];
+    for (size_t i = 0; i < slot.size();) {
+      if (slot[i].due <= now) {
+        due.push_back(std::move(slot[i].fn));
+        slot[i] = std::move(slot.back());
+        slot.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  }
+  tick = now;
+  ntimers -= static_cast<int>(due.size());
+  for (F<void ()> const& fn: due)
+    fn();
+}
+
+void Loop::runPosted() {
+  std::vector<F<void ()>> fns;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    fns.swap(posted);
+  }
+  for (F<void ()> const& fn: fns)
+    fn();
+}
+
+void Loop::wait() {
+  std::vector<F<void ()>> ready;
+  bool woken = false;
+  int ms = timeout();
+#ifdef __linux__
+  epoll_event events[32];
+  int n = epoll_wait(pollFd, events, 32, ms);
+  for (int i = 0; i < n; ++i) {
+    int fd = events[i].data.fd;
+    if (fd == wakeFd[0]) {
+      woken = true;
+      continue;
+    }
+    auto it = readers.find(fd);
+    if (it == readers.end()) continue;
+    ready.push_back(std::move(it->second));
+    readers.erase(it);
+    epoll_ctl(pollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  if (woken) {
+    std::uint64_t count;
+    ssize_t r = read(wakeFd[0], &count, sizeof(count));
+    (void)r;
+  }
+#else
+  std::vector<pollfd> fds;
+  fds.push_back(pollfd{wakeFd[0], POLLIN, 0});
+  for (auto const& reader: readers)
+    fds.push_back(pollfd{reader.first, POLLIN, 0});
+  int n = poll(fds.data(), static_cast<nfds_t>(fds.size()), ms);
+  for (int i = 0; n > 0 && i < static_cast<int>(fds.size()); ++i) {
+    if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+    if (i == 0) {
+      char buf[64];
+      while (read(wakeFd[0], buf, sizeof(buf)) > 0) {}
+      woken = true;
+      continue;
+    }
+    auto it = readers.find(fds[i].fd);
+    ready.push_back(std::move(it->second));
+    readers.erase(it);
+  }
+#endif
+  expire(nowMs());
+  for (F<void ()> const& fn: ready)
+    fn();
+  if (woken) runPosted();
+}
@@ -0,0 +1,73 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "ex.h"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// What evalSync falls back on once the ready queue has run dry: waits, using
+// no CPU, until a timer is due, an input source is ready or another thread
+// posts work, and runs the continuations that were waiting for it. There is
+// one per thread, returned by currentLoop().
+struct Loop {
+  static const int wheelSize = 256; // one slot per millisecond
+  struct Timer {
+    std::uint64_t due;
+    F<void ()> fn;
+  };
+  std::vector<Timer> wheel[wheelSize];
+  std::uint64_t tick; // timers due up to here have run
+  int ntimers;
+  std::unordered_map<int, F<void ()>> readers;
+  std::mutex mutex;
+  std::vector<F<void ()>> posted;
+  int pollFd;
+  int wakeFd[2];
+
+  Loop();
+  ~Loop();
+  Loop(Loop const&) = delete;
+  Loop& operator=(Loop const&) = delete;
+
+  void addTimer(int ms, F<void ()> fn);
+  void addReader(int fd, F<void ()> fn);
+  // Safe to call from any thread.
+  void post(F<void ()> fn);
+  // Blocks until at least one timer, reader or post is ready and runs it.
+  void wait();
+
+private:
+  int timeout() const;
+  void expire(std::uint64_t now);
+  void runPosted();
+};
+
+Loop& currentLoop();
+
+// Milliseconds on a monotonic clock.
+std::uint64_t nowMs();
+
+struct After {
+  int ms;
+  template <typename K> void operator()(K const& k) const { currentLoop().addTimer(ms, F<void ()>(promote(k))); }
+};
+
+// Finishes ms milliseconds after it starts.
+inline Node<void, After> after(int ms) {
+  return {After{ms}};
+}
+
+struct Readable {
+  int fd;
+  template <typename K> void operator()(K const& k) const { currentLoop().addReader(fd, F<void ()>(promote(k))); }
+};
+
+// Finishes once fd has input to read.
+inline Node<void, Readable> readable(int fd) {
+  return {Readable{fd}};
+}
+
+#endif // LOOP_H
@@ -0,0 +1,96 @@
+#include "pool.h"
+
+static thread_local Pool* workerPool = nullptr;
+static thread_local size_t workerIndex = 0;
+
+Pool::Pool(int count): queued(0), next(0), steals(0) {
+  size_t n = count > 0 ? static_cast<size_t>(count) : std::thread::hardware_concurrency();
+  if (n == 0) n = 1;
+  for (size_t i = 0; i < n; ++i)
+    workers.emplace_back(new Worker);
+  for (size_t i = 0; i < n; ++i)
+    threads.emplace_back(&Pool::run, this, i);
+}
+
+Pool::~Pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& thread: threads)
+    thread.join();
+}
+
+Pool* Pool::current() {
+  return workerPool;
+}
+
+static std::atomic<Pool*> chosenPool(nullptr);
+
+Pool& workPool() {
+  if (Pool* pool = chosenPool.load()) return *pool;
+  static Pool pool;
+  return pool;
+}
+
+void setWorkPool(Pool* pool) {
+  chosenPool = pool;
+}
+
+void Pool::submit(F<void ()> fn) {
+  size_t i = workerPool == this ? workerIndex : next++ % workers.size();
+  {
+    std::lock_guard<std::mutex> lock(workers[i]->mutex);
+    workers[i]->tasks.push_back(std::move(fn));
+  }
+  ++queued;
+  // Under the lock, so that a worker about to sleep either sees the task or
+  // is counted as sleeping.
+  std::lock_guard<std::mutex> lock(mutex);
+  if (sleeping) wake.notify_one();
+}
+
+bool Pool::take(size_t self, F<void ()>& fn) {
+  for (size_t n = 0; n < workers.size(); ++n) {
+    Worker& w = *workers[(self + n) % workers.size()];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.tasks.empty()) continue;
+    if (n == 0) {
+      fn = std::move(w.tasks.back());
+      w.tasks.pop_back();
+    } else {
+      fn = std::move(w.tasks.front());
+      w.tasks.pop_front();
+      ++steals;
+    }
+    --queued;
+    return true;
+  }
+  return false;
+}
+
+void Pool::run(size_t self) {
+  workerPool = this;
+  workerIndex = self;
+  // Deep chains in tasks bounce to this thread's queue, drained after each.
+  Trampoline& t = trampoline();
+  t.driving = true;
+  for (;;) {
+    F<void ()> fn;
+    if (take(self, fn)) {
+      fn();
+      while (!t.queue.empty()) {
+        F<void ()> step = std::move(t.queue.front());
+        t.queue.pop_front();
+        step();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    ++sleeping;
+    wake.wait(lock, [this] () { return stopping || queued > 0; });
+    --sleeping;
+    if (stopping && queued == 0) return;
+  }
+}
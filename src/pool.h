@@ -0,0 +1,211 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "ex.h"
+#include "loop.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Worker threads with a task deque each. A worker takes its own newest task
+// first and, when it has none, steals the oldest from another; tasks
+// submitted by a worker go to its own deque, others are dealt out in turn.
+struct Pool {
+  struct Worker {
+    std::mutex mutex;
+    std::deque<F<void ()>> tasks;
+  };
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::mutex mutex; // for sleeping
+  std::condition_variable wake;
+  int sleeping = 0;
+  std::atomic<long> queued;
+  std::atomic<unsigned> next;
+  std::atomic<long> steals;
+  bool stopping = false;
+
+  // With no count, one thread per hardware thread.
+  explicit Pool(int count = 0);
+  ~Pool();
+  Pool(Pool const&) = delete;
+  Pool& operator=(Pool const&) = delete;
+
+  void submit(F<void ()> fn);
+  // The pool whose worker is running this thread, if any.
+  static Pool* current();
+
+private:
+  bool take(size_t self, F<void ()>& fn);
+  void run(size_t self);
+};
+
+// The pool all() and both() use: the one last given to setWorkPool(), or
+// else one with a thread per hardware thread, made when first needed.
+Pool& workPool();
+void setWorkPool(Pool* pool);
+
+// Calls k once every branch of a join has finished. Off the pool, that is
+// done on the starting thread's loop, which evalSync is waiting on there;
+// on a worker it is done by whichever worker finishes last. A task awaiting
+// the join is then resumed on that worker, possibly while the one that
+// started it is still suspending it, which ExAwaiter allows for.
+template <typename K> struct JoinCont {
+  K k;
+  Loop* origin;
+  std::atomic<int> left;
+  JoinCont(K const& k_, int n): k(k_), origin(Pool::current() ? nullptr : &currentLoop()), left(n) {}
+};
+
+template <typename J, typename V> void joined(std::shared_ptr<J> const& j, V const& v) {
+  if (!j->origin) {
+    j->k(v);
+    return;
+  }
+  std::shared_ptr<J> j_ = j;
+  j->origin->post([j_, v] () { j_->k(v); });
+}
+
+template <typename J> void joined(std::shared_ptr<J> const& j) {
+  if (!j->origin) {
+    j->k();
+    return;
+  }
+  std::shared_ptr<J> j_ = j;
+  j->origin->post([j_] () { j_->k(); });
+}
+
+// Branches that pass on nothing only count down.
+template <typename J> struct VoidBranch {
+  std::shared_ptr<J> j;
+  void operator()() const {
+    if (--j->left == 0) joined(j);
+  }
+};
+
+// both() passes on a pair, or nothing when neither branch passes on a value.
+template <typename A, typename B> struct BothOf {typedef std::pair<A, B> Type;};
+template <> struct BothOf<void, void> {typedef void Type;};
+
+template <typename A, typename B, typename K> struct BothJoin: JoinCont<K> {
+  Result<typename A::Type> a;
+  Result<typename B::Type> b;
+  explicit BothJoin(K const& k): JoinCont<K>(k, 2) {}
+};
+
+template <typename J, typename R, R J::*M> struct BothBranch {
+  std::shared_ptr<J> j;
+  template <typename V> void operator()(V const& v) const {
+    (j.get()->*M)(v);
+    if (--j->left == 0) joined(j, std::make_pair(j->a.get(), j->b.get()));
+  }
+};
+
+// Runs a and b at the same time on the pool, and passes on both results.
+template <typename A, typename B, typename T = typename BothOf<typename A::Type, typename B::Type>::Type>
+struct Both {
+  A a;
+  B b;
+  template <typename K> void operator()(K const& k) const {
+    using J = BothJoin<A, B, Promoted<K>>;
+    using RA = Result<typename A::Type>;
+    using RB = Result<typename B::Type>;
+    std::shared_ptr<J> j = std::make_shared<J>(promote(k));
+    A a_ = a;
+    B b_ = b;
+    Pool& pool = workPool();
+    pool.submit([a_, j] () { a_(BothBranch<J, RA, &J::a>{j}); });
+    pool.submit([b_, j] () { b_(BothBranch<J, RB, &J::b>{j}); });
+  }
+};
+
+template <typename A, typename B> struct Both<A, B, void> {
+  A a;
+  B b;
+  template <typename K> void operator()(K const& k) const {
+    using J = JoinCont<Promoted<K>>;
+    std::shared_ptr<J> j = std::make_shared<J>(promote(k), 2);
+    A a_ = a;
+    B b_ = b;
+    Pool& pool = workPool();
+    pool.submit([a_, j] () { a_(VoidBranch<J>{j}); });
+    pool.submit([b_, j] () { b_(VoidBranch<J>{j}); });
+  }
+};
+
+// The branches run on worker threads, outside of dependency tracking and of
+// the thread's loop: they are for pure work, such as measuring text, and
+// must not wait on timers or input. Nested joins on a worker do not block it.
+template <typename A, typename B>
+Node<typename BothOf<typename A::Type, typename B::Type>::Type, Both<A, B>> both(A const& a, B const& b) {
+  return {Both<A, B>{a, b}};
+}
+
+template <typename T, typename K> struct AllJoin: JoinCont<K> {
+  std::vector<Result<T>> results;
+  AllJoin(K const& k, size_t n): JoinCont<K>(k, static_cast<int>(n)), results(n) {}
+};
+
+template <typename T, typename J> struct AllBranch {
+  std::shared_ptr<J> j;
+  size_t i;
+  template <typename V> void operator()(V const& v) const {
+    j->results[i](v);
+    if (--j->left != 0) return;
+    std::vector<T> values;
+    values.reserve(j->results.size());
+    for (Result<T>& r: j->results)
+      values.push_back(r.get());
+    joined(j, values);
+  }
+};
+
+// all() passes on a vector of results, or nothing for void branches.
+template <typename T> struct AllOf {typedef std::vector<T> Type;};
+template <> struct AllOf<void> {typedef void Type;};
+
+template <typename E, typename T = typename E::Type> struct All {
+  std::vector<E> es;
+  template <typename K> void operator()(K const& k) const {
+    if (es.empty()) {
+      k(std::vector<T>());
+      return;
+    }
+    using J = AllJoin<T, Promoted<K>>;
+    std::shared_ptr<J> j = std::make_shared<J>(promote(k), es.size());
+    Pool& pool = workPool();
+    for (size_t i = 0; i < es.size(); ++i) {
+      E e = es[i];
+      pool.submit([e, j, i] () { e(AllBranch<T, J>{j, i}); });
+    }
+  }
+};
+
+template <typename E> struct All<E, void> {
+  std::vector<E> es;
+  template <typename K> void operator()(K const& k) const {
+    if (es.empty()) {
+      k();
+      return;
+    }
+    using J = JoinCont<Promoted<K>>;
+    std::shared_ptr<J> j = std::make_shared<J>(promote(k), static_cast<int>(es.size()));
+    Pool& pool = workPool();
+    for (E const& e: es)
+      pool.submit([e, j] () { e(VoidBranch<J>{j}); });
+  }
+};
+
+// Runs every expression at the same time on the pool, as with both(), and
+// passes on their results in order.
+template <typename E> Node<typename AllOf<typename E::Type>::Type, All<E>> all(std::vector<E> const& es) {
+  return {All<E>{es}};
+}
+
+#endif // POOL_H
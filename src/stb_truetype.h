@@ -233,12 +233,6 @@ int main(int arg, char **argv)
    typedef char stbtt__check_size32[sizeof(stbtt_int32)==4 ? 1 : -1];
    typedef char stbtt__check_size16[sizeof(stbtt_int16)==2 ? 1 : -1];
 
-   // #define your own STBTT_sort() to override this to avoid qsort
-   #ifndef STBTT_sort
-   #include <stdlib.h>
-   #define STBTT_sort(data,num_items,item_size,compare_func)   qsort(data,num_items,item_size,compare_func)
-   #endif
-
    // #define your own STBTT_ifloor/STBTT_iceil() to avoid math.h
    #ifndef STBTT_ifloor
    #include <math.h>
@@ -246,11 +240,29 @@ int main(int arg, char **argv)
    #define STBTT_iceil(x)    ((int) ceil(x))
    #endif
 
-   // #define your own functions "STBTT_malloc" / "STBTT_free" to avoid malloc.h
+   #ifndef STBTT_fabs
+   #include <math.h>
+   #define STBTT_fabs(x)     fabs(x)
+   #endif
+
+   // #define STBTT_RASTERIZER_VERSION 2 to render with exact-area coverage
+   // instead of vertical supersampling
+   #ifndef STBTT_RASTERIZER_VERSION
+   #define STBTT_RASTERIZER_VERSION 1
+   #endif
+
+   // #define your own functions "STBTT_malloc" / "STBTT_free" to avoid malloc.h,
+   // or #define STBTT_ARENA to allocate from the stbtt_arena in userdata
    #ifndef STBTT_malloc
+   #ifdef STBTT_ARENA
+   #include <stdlib.h>
+   #define STBTT_malloc(x,u)  stbtt_ArenaAlloc((stbtt_arena *) (u), x)
+   #define STBTT_free(x,u)    stbtt_ArenaFree((stbtt_arena *) (u), x)
+   #else
    #include <malloc.h>
-   #define STBTT_malloc(x,u)  malloc(x)
-   #define STBTT_free(x,u)    free(x)
+   #define STBTT_malloc(x,u)  ((void)(u),malloc(x))
+   #define STBTT_free(x,u)    ((void)(u),free(x))
+   #endif
    #endif
 
    #ifndef STBTT_assert
@@ -280,6 +292,8 @@ int main(int arg, char **argv)
 #ifndef __STB_INCLUDE_STB_TRUETYPE_H__
 #define __STB_INCLUDE_STB_TRUETYPE_H__
 
+#include <stddef.h> // size_t
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -476,6 +490,28 @@ extern unsigned char *stbtt_GetGlyphBitmap(const stbtt_fontinfo *info, float sca
 extern void stbtt_GetGlyphBitmapBox(const stbtt_fontinfo *font, int glyph, float scale_x, float scale_y, int *ix0, int *iy0, int *ix1, int *iy1);
 extern void stbtt_MakeGlyphBitmap(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph);
 
+extern void stbtt_MakeGlyphBitmapFromShape(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph, stbtt_vertex *vertices, int num_verts);
+// the same as stbtt_MakeGlyphBitmap, but renders vertices previously
+// returned by stbtt_GetGlyphShape for 'glyph' instead of parsing them
+// again. lets you keep parsed outlines around and render them at many sizes.
+
+typedef struct
+{
+   int glyph;
+   float scale_x, scale_y;
+   int x,y,w,h;             // rect in the output buffer, sized as by stbtt_GetGlyphBitmapBox
+   stbtt_vertex *vertices;  // outline from stbtt_GetGlyphShape, or NULL to parse it here
+   int num_verts;
+} stbtt_glyphjob;
+
+extern void stbtt_MakeGlyphBitmaps(const stbtt_fontinfo *info, unsigned char *output, int out_stride, const stbtt_glyphjob *jobs, int num_jobs);
+// renders each job into its rect of 'output', as stbtt_MakeGlyphBitmap
+// would, sharing one set of scratch memory across all of them: when built
+// with STBTT_ARENA and info->userdata is an arena, it is reset after every
+// job. rects must not overlap. to split a batch across threads, call this on
+// disjoint ranges of jobs, giving each thread a copy of the fontinfo with
+// its own arena.
+
 //extern void stbtt_get_true_bbox(stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int *ix0, int *iy0, int *ix1, int *iy1);
 
 // @TODO: don't expose this structure
@@ -487,6 +523,62 @@ typedef struct
 
 extern void stbtt_Rasterize(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, void *userdata);
 
+extern void stbtt_RasterizeWithVersion(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, int version, void *userdata);
+// as above, but picks the rasterizer at runtime instead of using
+// STBTT_RASTERIZER_VERSION. version 1 supersamples each pixel row 5 or 15
+// times and box filters the result; version 2 computes the exact area of
+// each pixel covered by the outline in a single pass. this is mostly
+// useful for comparing the two.
+
+typedef void stbtt_tile_func(void *ctx, int x, int y, int w, int h, const unsigned char *pixels, int stride);
+
+extern void stbtt_RasterizeTiled(int w, int h, int tile_size, int skip_empty, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, stbtt_tile_func *emit, void *ctx, void *userdata);
+// renders the w*h bitmap that stbtt_Rasterize would, but in tiles of at
+// most tile_size*tile_size pixels, passing each to 'emit' with its position
+// in the bitmap; the pixels are only valid during the call. one row of
+// tiles is rendered at a time, so scratch memory is w*tile_size bytes plus
+// what the outline needs, however tall the bitmap. with skip_empty, tiles
+// with no coverage are not emitted.
+
+extern int stbtt_TessellateShape(stbtt_vertex *vertices, int num_verts, float objspace_flatness, float **triangles, void *userdata);
+extern void stbtt_FreeTriangles(float *triangles, void *userdata);
+// fills the inside of the shape (non-zero winding) with triangles instead
+// of rendering it: returns how many, and points *triangles at 6 floats per
+// triangle, three x,y corners in the shape's own units (y up). curves are
+// flattened to within objspace_flatness. the inside is cut into horizontal
+// trapezoids at every vertex height, so contours that cross each other
+// between two vertices come out slightly wrong near the crossing.
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// SCRATCH ARENA
+//
+// If you #define STBTT_ARENA before the implementation, every allocation
+// made while parsing and rasterizing goes to the stbtt_arena pointed to by
+// the fontinfo's userdata (or plain malloc if userdata is NULL). Frees are
+// deferred until stbtt_ArenaReset(), which also grows the arena to cover
+// everything the last glyph needed, so after the first few glyphs
+// rasterizing performs no heap allocations at all. An arena must only be
+// used by one thread at a time; give each thread its own.
+//
+// Anything allocated from the arena, including the bitmaps returned by
+// stbtt_GetGlyphBitmap(), is invalid after the next reset.
+
+typedef struct
+{
+   unsigned char *base;          // current block
+   unsigned int   size, used;
+   void          *overflow;      // heap blocks handed out since the last reset
+   unsigned int   overflow_size; // bytes requested from those blocks
+   int            heap_allocs;   // total blocks ever taken from the heap
+} stbtt_arena;
+
+extern void  stbtt_ArenaInit(stbtt_arena *arena, unsigned int size);
+extern void *stbtt_ArenaAlloc(stbtt_arena *arena, size_t size);
+extern void  stbtt_ArenaFree(stbtt_arena *arena, void *p);
+extern void  stbtt_ArenaReset(stbtt_arena *arena);
+extern void  stbtt_ArenaRelease(stbtt_arena *arena);
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Finding the right font...
@@ -664,7 +756,7 @@ int stbtt_GetFontOffsetForIndex(const unsigned char *font_collection, int index)
          stbtt_int32 n = ttLONG(font_collection+8);
          if (index >= n)
             return -1;
-         return ttLONG(font_collection+12+index*14);
+         return ttLONG(font_collection+12+index*4);
       }
    }
    return -1;
@@ -1119,7 +1211,7 @@ float stbtt_ScaleForPixelHeight(const stbtt_fontinfo *info, float height)
    return (float) height / fheight;
 }
 
-void stbtt_FreeShape(const stbtt_fontinfo* /*info*/, stbtt_vertex* v)
+void stbtt_FreeShape(const stbtt_fontinfo *info, stbtt_vertex* v)
 {
    STBTT_free(v, info->userdata);
 }
@@ -1151,11 +1243,245 @@ typedef struct stbtt__edge {
    int invert;
 } stbtt__edge;
 
-typedef struct stbtt__active_edge
+//////////////////////////////////////////////////////////////////////////////
+//
+// scanline kernels
+//
+// Filling spans of the supersampled scanline, and resolving the exact-area
+// coverage buffers to 8-bit alpha, are done by kernels picked at runtime:
+// AVX2 where the CPU has it, otherwise SSE2 or NEON when the target
+// guarantees them, otherwise plain C. #define STBTT_NO_SIMD to always use
+// the C versions. The vector resolve sums the fill buffer in a different
+// order, so it can differ from the C version by one level in rare pixels.
+
+#ifndef STBTT_NO_SIMD
+   #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+      #define STBTT__SSE2
+      #include <emmintrin.h>
+      #if defined(__GNUC__) || defined(__clang__)
+         #define STBTT__AVX2
+         #include <immintrin.h>
+      #endif
+   #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+      #define STBTT__NEON
+      #include <arm_neon.h>
+   #endif
+#endif
+
+// adds 'weight' to each of n bytes, wrapping like the scalar add would
+typedef void stbtt__span_add_func(unsigned char *p, int n, stbtt_uint8 weight);
+// out[i] = clamp(|cover[i] + fill[0] + ... + fill[i]| * 255)
+typedef void stbtt__resolve_func(const float *cover, const float *fill, unsigned char *out, int n);
+
+static void stbtt__span_add_c(unsigned char *p, int n, stbtt_uint8 weight)
+{
+   int i;
+   for (i=0; i < n; ++i)
+      p[i] = p[i] + weight;
+}
+
+static int stbtt__resolve_pixel(float k)
+{
+   int m;
+   if (k < 0) k = -k;
+   k = k*255 + 0.5f;
+   if (k > 255) k = 255;
+   m = (int) k;
+   return m;
+}
+
+#if !defined(STBTT__SSE2) && !defined(STBTT__NEON)
+static void stbtt__resolve_c(const float *cover, const float *fill, unsigned char *out, int n)
+{
+   float sum = 0;
+   int i;
+   for (i=0; i < n; ++i) {
+      sum += fill[i];
+      out[i] = (unsigned char) stbtt__resolve_pixel(cover[i] + sum);
+   }
+}
+#endif
+
+#ifdef STBTT__SSE2
+static void stbtt__span_add_sse2(unsigned char *p, int n, stbtt_uint8 weight)
+{
+   __m128i w = _mm_set1_epi8((char) weight);
+   int i = 0;
+   for (; i+16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128((__m128i *) (p+i));
+      _mm_storeu_si128((__m128i *) (p+i), _mm_add_epi8(v, w));
+   }
+   stbtt__span_add_c(p+i, n-i, weight);
+}
+
+// resolves 4 pixels; 'sum' carries the running fill total in every lane
+static __m128i stbtt__resolve4_sse2(const float *cover, const float *fill, __m128 *sum)
+{
+   const __m128 sign = _mm_set1_ps(-0.0f);
+   __m128 x = _mm_loadu_ps(fill);
+   // inclusive prefix sum across the lanes
+   x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+   x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+   x = _mm_add_ps(x, *sum);
+   *sum = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3,3,3,3));
+   x = _mm_andnot_ps(sign, _mm_add_ps(x, _mm_loadu_ps(cover)));
+   x = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+   x = _mm_min_ps(x, _mm_set1_ps(255.0f));
+   return _mm_cvttps_epi32(x);
+}
+
+static void stbtt__resolve_sse2(const float *cover, const float *fill, unsigned char *out, int n)
+{
+   __m128 sum = _mm_setzero_ps();
+   float s;
+   int i = 0;
+   for (; i+8 <= n; i += 8) {
+      __m128i a = stbtt__resolve4_sse2(cover+i, fill+i, &sum);
+      __m128i b = stbtt__resolve4_sse2(cover+i+4, fill+i+4, &sum);
+      __m128i p = _mm_packs_epi32(a, b);
+      _mm_storel_epi64((__m128i *) (out+i), _mm_packus_epi16(p, p));
+   }
+   s = _mm_cvtss_f32(sum);
+   for (; i < n; ++i) {
+      s += fill[i];
+      out[i] = (unsigned char) stbtt__resolve_pixel(cover[i] + s);
+   }
+}
+#endif
+
+#ifdef STBTT__AVX2
+__attribute__((target("avx2")))
+static void stbtt__span_add_avx2(unsigned char *p, int n, stbtt_uint8 weight)
+{
+   __m256i w = _mm256_set1_epi8((char) weight);
+   int i = 0;
+   for (; i+32 <= n; i += 32) {
+      __m256i v = _mm256_loadu_si256((__m256i *) (p+i));
+      _mm256_storeu_si256((__m256i *) (p+i), _mm256_add_epi8(v, w));
+   }
+   stbtt__span_add_c(p+i, n-i, weight);
+}
+
+__attribute__((target("avx2")))
+static void stbtt__resolve_avx2(const float *cover, const float *fill, unsigned char *out, int n)
+{
+   const __m256 sign = _mm256_set1_ps(-0.0f);
+   __m256 sum = _mm256_setzero_ps();
+   float s;
+   int i = 0;
+   for (; i+8 <= n; i += 8) {
+      __m256 x = _mm256_loadu_ps(fill+i), t;
+      __m256i m;
+      __m128i p;
+      // prefix sum within each 128-bit half, then carry the low half's total
+      // into the high half
+      x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4)));
+      x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+      t = _mm256_permute_ps(x, _MM_SHUFFLE(3,3,3,3));
+      x = _mm256_add_ps(x, _mm256_permute2f128_ps(t, t, 0x08));
+      x = _mm256_add_ps(x, sum);
+      t = _mm256_permute_ps(x, _MM_SHUFFLE(3,3,3,3));
+      sum = _mm256_permute2f128_ps(t, t, 0x11);
+
+      x = _mm256_andnot_ps(sign, _mm256_add_ps(x, _mm256_loadu_ps(cover+i)));
+      x = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f));
+      x = _mm256_min_ps(x, _mm256_set1_ps(255.0f));
+      m = _mm256_cvttps_epi32(x);
+      p = _mm_packs_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+      _mm_storel_epi64((__m128i *) (out+i), _mm_packus_epi16(p, p));
+   }
+   s = _mm_cvtss_f32(_mm256_castps256_ps128(sum));
+   for (; i < n; ++i) {
+      s += fill[i];
+      out[i] = (unsigned char) stbtt__resolve_pixel(cover[i] + s);
+   }
+}
+#endif
+
+#ifdef STBTT__NEON
+static void stbtt__span_add_neon(unsigned char *p, int n, stbtt_uint8 weight)
+{
+   uint8x16_t w = vdupq_n_u8(weight);
+   int i = 0;
+   for (; i+16 <= n; i += 16)
+      vst1q_u8(p+i, vaddq_u8(vld1q_u8(p+i), w));
+   stbtt__span_add_c(p+i, n-i, weight);
+}
+
+// resolves 4 pixels; 'sum' carries the running fill total in every lane
+static uint16x4_t stbtt__resolve4_neon(const float *cover, const float *fill, float32x4_t *sum)
+{
+   const float32x4_t zero = vdupq_n_f32(0);
+   float32x4_t x = vld1q_f32(fill);
+   x = vaddq_f32(x, vextq_f32(zero, x, 3));
+   x = vaddq_f32(x, vextq_f32(zero, x, 2));
+   x = vaddq_f32(x, *sum);
+   *sum = vdupq_n_f32(vgetq_lane_f32(x, 3));
+   x = vabsq_f32(vaddq_f32(x, vld1q_f32(cover)));
+   x = vaddq_f32(vmulq_f32(x, vdupq_n_f32(255.0f)), vdupq_n_f32(0.5f));
+   x = vminq_f32(x, vdupq_n_f32(255.0f));
+   return vmovn_u32(vcvtq_u32_f32(x));
+}
+
+static void stbtt__resolve_neon(const float *cover, const float *fill, unsigned char *out, int n)
+{
+   float32x4_t sum = vdupq_n_f32(0);
+   float s;
+   int i = 0;
+   for (; i+8 <= n; i += 8) {
+      uint16x4_t a = stbtt__resolve4_neon(cover+i, fill+i, &sum);
+      uint16x4_t b = stbtt__resolve4_neon(cover+i+4, fill+i+4, &sum);
+      vst1_u8(out+i, vmovn_u16(vcombine_u16(a, b)));
+   }
+   s = vgetq_lane_f32(sum, 0);
+   for (; i < n; ++i) {
+      s += fill[i];
+      out[i] = (unsigned char) stbtt__resolve_pixel(cover[i] + s);
+   }
+}
+#endif
+
+typedef struct
+{
+   stbtt__span_add_func *span_add;
+   stbtt__resolve_func  *resolve;
+} stbtt__kernel_set;
+
+#if defined(STBTT__NEON)
+static const stbtt__kernel_set stbtt__kernels_default = { stbtt__span_add_neon, stbtt__resolve_neon };
+#elif defined(STBTT__SSE2)
+static const stbtt__kernel_set stbtt__kernels_default = { stbtt__span_add_sse2, stbtt__resolve_sse2 };
+#else
+static const stbtt__kernel_set stbtt__kernels_default = { stbtt__span_add_c, stbtt__resolve_c };
+#endif
+
+#ifdef STBTT__AVX2
+static const stbtt__kernel_set stbtt__kernels_avx2 = { stbtt__span_add_avx2, stbtt__resolve_avx2 };
+static const stbtt__kernel_set *stbtt__kernels_picked;
+
+// picks the kernels on first use. the choice is published as one pointer
+// with an atomic store, so other threads see either no choice or a whole
+// one; threads that race to pick store the same pointer
+static const stbtt__kernel_set *stbtt__kernels(void)
+{
+   const stbtt__kernel_set *k = __atomic_load_n(&stbtt__kernels_picked, __ATOMIC_ACQUIRE);
+   if (!k) {
+      k = __builtin_cpu_supports("avx2") ? &stbtt__kernels_avx2 : &stbtt__kernels_default;
+      __atomic_store_n(&stbtt__kernels_picked, k, __ATOMIC_RELEASE);
+   }
+   return k;
+}
+#else
+static const stbtt__kernel_set *stbtt__kernels(void)
+{
+   return &stbtt__kernels_default;
+}
+#endif
+
+typedef struct
 {
    int x,dx;
    float ey;
-   struct stbtt__active_edge *next;
    int valid;
 } stbtt__active_edge;
 
@@ -1163,12 +1489,61 @@ typedef struct stbtt__active_edge
 #define FIX        (1 << FIXSHIFT)
 #define FIXMASK    (FIX-1)
 
-static stbtt__active_edge *new_active(stbtt__edge *e, int off_x, float start_point, void* /*userdata*/)
+// active edges are allocated in chunks and recycled through a free list,
+// rather than going to STBTT_malloc for every edge
+typedef struct stbtt__hheap_chunk
+{
+   struct stbtt__hheap_chunk *next;
+} stbtt__hheap_chunk;
+
+typedef struct
+{
+   stbtt__hheap_chunk *head;
+   void *first_free;
+   int   num_remaining_in_head_chunk;
+} stbtt__hheap;
+
+static void *stbtt__hheap_alloc(stbtt__hheap *hh, size_t size, void *userdata)
+{
+   if (hh->first_free) {
+      void *p = hh->first_free;
+      hh->first_free = * (void **) p;
+      return p;
+   } else {
+      if (hh->num_remaining_in_head_chunk == 0) {
+         int count = (size < 32 ? 2000 : size < 128 ? 800 : 100);
+         stbtt__hheap_chunk *c = (stbtt__hheap_chunk *) STBTT_malloc(sizeof(stbtt__hheap_chunk) + size * (unsigned)count, userdata);
+         if (c == NULL)
+            return NULL;
+         c->next = hh->head;
+         hh->head = c;
+         hh->num_remaining_in_head_chunk = count;
+      }
+      --hh->num_remaining_in_head_chunk;
+      return (char *) (hh->head) + sizeof(stbtt__hheap_chunk) + size * (unsigned)hh->num_remaining_in_head_chunk;
+   }
+}
+
+static void stbtt__hheap_free(stbtt__hheap *hh, void *p)
+{
+   * (void **) p = hh->first_free;
+   hh->first_free = p;
+}
+
+static void stbtt__hheap_cleanup(stbtt__hheap *hh, void *userdata)
+{
+   stbtt__hheap_chunk *c = hh->head;
+   while (c) {
+      stbtt__hheap_chunk *n = c->next;
+      STBTT_free(c, userdata);
+      c = n;
+   }
+}
+
+static void stbtt__init_active(stbtt__active_edge *z, stbtt__edge *e, int off_x, float start_point)
 {
-   stbtt__active_edge *z = (stbtt__active_edge *) STBTT_malloc(sizeof(*z), userdata); // @TODO: make a pool of these!!!
    float dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
    STBTT_assert(e->y0 <= start_point);
-   if (!z) return z;
    // round dx down to avoid going too far
    if (dxdy < 0)
       z->dx = -STBTT_ifloor(FIX * -dxdy);
@@ -1177,20 +1552,19 @@ static stbtt__active_edge *new_active(stbtt__edge *e, int off_x, float start_poi
    z->x = STBTT_ifloor(FIX * (e->x0 + dxdy * (start_point - e->y0)));
    z->x -= off_x * FIX;
    z->ey = e->y1;
-   z->next = 0;
    z->valid = e->invert ? 1 : -1;
-   return z;
 }
 
 // note: this routine clips fills that extend off the edges... ideally this
 // wouldn't happen, but it could happen if the truetype glyph bounding boxes
 // are wrong, or if the user supplies a too-small bitmap
-static void stbtt__fill_active_edges(unsigned char *scanline, int len, stbtt__active_edge *e, int max_weight)
+static void stbtt__fill_active_edges(unsigned char *scanline, int len, stbtt__active_edge *active, int num_active, int max_weight)
 {
    // non-zero winding fill
-   int x0=0, w=0;
+   int x0=0, w=0, k;
 
-   while (e) {
+   for (k=0; k < num_active; ++k) {
+      stbtt__active_edge *e = &active[k];
       if (w == 0) {
          // if we're currently at zero, we need to record the edge start point
          x0 = e->x; w += e->valid;
@@ -1216,25 +1590,37 @@ static void stbtt__fill_active_edges(unsigned char *scanline, int len, stbtt__ac
                   else
                      j = len; // clip
 
-                  for (++i; i < j; ++i) // fill pixels between x0 and x1
-                     scanline[i] = scanline[i] + (stbtt_uint8) max_weight;
+                  // fill pixels between x0 and x1
+                  if (j-i > 16)
+                     stbtt__kernels()->span_add(scanline+i+1, j-i-1, (stbtt_uint8) max_weight);
+                  else
+                     for (++i; i < j; ++i)
+                        scanline[i] = scanline[i] + (stbtt_uint8) max_weight;
                }
             }
          }
       }
-
-      e = e->next;
    }
 }
 
+// the active edges are kept in an array sorted by x. edges only move a
+// little from one scanline to the next, so the array stays nearly sorted
+// and insertion sort keeps it ordered in close to linear time, even for
+// complex glyphs with many contours
 static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int off_x, int off_y, void *userdata)
 {
-   stbtt__active_edge *active = NULL;
+   stbtt__active_edge *active;
+   int num_active=0;
    int y,j=0;
    int max_weight = (255 / vsubsample);  // weight per vertical scanline
    int s; // vertical subsample index
    unsigned char scanline_data[512], *scanline;
 
+   // no more than n edges can ever be active at once
+   active = (stbtt__active_edge *) STBTT_malloc(sizeof(*active) * (unsigned)(n > 0 ? n : 1), userdata);
+   if (!active)
+      return;
+
    if (result->w > 512)
       scanline = (unsigned char *) STBTT_malloc((unsigned)result->w, userdata);
    else
@@ -1248,69 +1634,51 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       for (s=0; s < vsubsample; ++s) {
          // find center of pixel for this scanline
          float scan_y = y + 0.5f;
-         stbtt__active_edge **step = &active;
+         int i,k;
 
          // update all active edges;
          // remove all active edges that terminate before the center of this scanline
-         while (*step) {
-            stbtt__active_edge * z = *step;
-            if (z->ey <= scan_y) {
-               *step = z->next; // delete from list
-               STBTT_assert(z->valid);
-               z->valid = 0;
-               STBTT_free(z, userdata);
-            } else {
-               z->x += z->dx; // advance to position for current scanline
-               step = &((*step)->next); // advance through list
+         for (i=k=0; i < num_active; ++i) {
+            if (active[i].ey > scan_y) {
+               active[k] = active[i];
+               active[k].x += active[k].dx; // advance to position for current scanline
+               ++k;
             }
          }
-
-         // resort the list if needed
-         for(;;) {
-            int changed=0;
-            step = &active;
-            while (*step && (*step)->next) {
-               if ((*step)->x > (*step)->next->x) {
-                  stbtt__active_edge *t = *step;
-                  stbtt__active_edge *q = t->next;
-
-                  t->next = q->next;
-                  q->next = t;
-                  *step = q;
-                  changed = 1;
-               }
-               step = &(*step)->next;
+         num_active = k;
+
+         // resort the array if needed
+         for (i=1; i < num_active; ++i) {
+            if (active[i-1].x > active[i].x) {
+               stbtt__active_edge t = active[i];
+               k = i;
+               do {
+                  active[k] = active[k-1];
+                  --k;
+               } while (k > 0 && active[k-1].x > t.x);
+               active[k] = t;
             }
-            if (!changed) break;
          }
 
          // insert all edges that start before the center of this scanline -- omit ones that also end on this scanline
          while (e->y0 <= scan_y) {
             if (e->y1 > scan_y) {
-               stbtt__active_edge *z = new_active(e, off_x, scan_y, userdata);
-               // find insertion point
-               if (active == NULL)
-                  active = z;
-               else if (z->x < active->x) {
-                  // insert at front
-                  z->next = active;
-                  active = z;
-               } else {
-                  // find thing to insert AFTER
-                  stbtt__active_edge *p = active;
-                  while (p->next && p->next->x < z->x)
-                     p = p->next;
-                  // at this point, p->next->x is NOT < z->x
-                  z->next = p->next;
-                  p->next = z;
+               stbtt__active_edge t;
+               stbtt__init_active(&t, e, off_x, scan_y);
+               // insert ahead of any edges at the same x
+               k = num_active++;
+               while (k > 0 && active[k-1].x >= t.x) {
+                  active[k] = active[k-1];
+                  --k;
                }
+               active[k] = t;
             }
             ++e;
          }
 
          // now process all active edges in XOR fashion
-         if (active)
-            stbtt__fill_active_edges(scanline, result->w, active, max_weight);
+         if (num_active)
+            stbtt__fill_active_edges(scanline, result->w, active, num_active, max_weight);
 
          ++y;
       }
@@ -1318,24 +1686,356 @@ static void stbtt__rasterize_sorted_edges(stbtt__bitmap *result, stbtt__edge *e,
       ++j;
    }
 
-   while (active) {
-      stbtt__active_edge *z = active;
-      active = active->next;
-      STBTT_free(z, userdata);
+   if (scanline != scanline_data)
+      STBTT_free(scanline, userdata);
+   STBTT_free(active, userdata);
+}
+
+// exact-area rasterizer: each edge deposits the signed area it covers in
+// the pixels it crosses into 'scanline', and the height it spans into
+// 'scanline_fill' for everything to its right, so one pass per pixel row
+// gives exact box-filtered coverage with no vertical supersampling
+
+typedef struct stbtt__area_edge
+{
+   struct stbtt__area_edge *next;
+   float fx,fdx,fdy;
+   float direction;
+   float sy;
+   float ey;
+} stbtt__area_edge;
+
+static stbtt__area_edge *stbtt__new_area_edge(stbtt__hheap *hh, stbtt__edge *e, int off_x, float start_point, void *userdata)
+{
+   stbtt__area_edge *z = (stbtt__area_edge *) stbtt__hheap_alloc(hh, sizeof(*z), userdata);
+   float dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+   if (!z) return z;
+   z->fdx = dxdy;
+   z->fdy = dxdy != 0.0f ? (1.0f/dxdy) : 0.0f;
+   z->fx = e->x0 + dxdy * (start_point - e->y0);
+   z->fx -= off_x;
+   z->direction = e->invert ? 1.0f : -1.0f;
+   z->sy = e->y0;
+   z->ey = e->y1;
+   z->next = 0;
+   return z;
+}
+
+// the edge passed in here does not cross the vertical line at x or the vertical line at x+1
+// (i.e. it has already been clipped to those)
+static void stbtt__handle_clipped_edge(float *scanline, int x, stbtt__area_edge *e, float x0, float y0, float x1, float y1)
+{
+   if (y0 == y1) return;
+   STBTT_assert(y0 < y1);
+   STBTT_assert(e->sy <= e->ey);
+   if (y0 > e->ey) return;
+   if (y1 < e->sy) return;
+   if (y0 < e->sy) {
+      x0 += (x1-x0) * (e->sy - y0) / (y1-y0);
+      y0 = e->sy;
+   }
+   if (y1 > e->ey) {
+      x1 += (x1-x0) * (e->ey - y1) / (y1-y0);
+      y1 = e->ey;
+   }
+
+   if (x0 <= x && x1 <= x)
+      scanline[x] += e->direction * (y1-y0);
+   else if (x0 >= x+1 && x1 >= x+1)
+      return;
+   else
+      scanline[x] += e->direction * (y1-y0) * (1-((x0-x)+(x1-x))/2); // coverage = 1 - average x position
+}
+
+static void stbtt__fill_area_edges(float *scanline, float *scanline_fill, int len, stbtt__area_edge *e, float y_top)
+{
+   float y_bottom = y_top+1;
+
+   while (e) {
+      // compute intersection points with top & bottom
+      STBTT_assert(e->ey >= y_top);
+
+      if (e->fdx == 0) {
+         float x0 = e->fx;
+         if (x0 < len) {
+            if (x0 >= 0) {
+               stbtt__handle_clipped_edge(scanline,(int) x0,e, x0,y_top, x0,y_bottom);
+               stbtt__handle_clipped_edge(scanline_fill-1,(int) x0+1,e, x0,y_top, x0,y_bottom);
+            } else {
+               stbtt__handle_clipped_edge(scanline_fill-1,0,e, x0,y_top, x0,y_bottom);
+            }
+         }
+      } else {
+         float x0 = e->fx;
+         float dx = e->fdx;
+         float xb = x0 + dx;
+         float x_top, x_bottom;
+         float sy0,sy1;
+         float dy = e->fdy;
+         STBTT_assert(e->sy <= y_bottom && e->ey >= y_top);
+
+         // compute endpoints of line segment clipped to this scanline (if the
+         // line segment starts on this scanline. x0 is the intersection of the
+         // line with y_top, but that may be off the line segment.
+         if (e->sy > y_top) {
+            x_top = x0 + dx * (e->sy - y_top);
+            sy0 = e->sy;
+         } else {
+            x_top = x0;
+            sy0 = y_top;
+         }
+         if (e->ey < y_bottom) {
+            x_bottom = x0 + dx * (e->ey - y_top);
+            sy1 = e->ey;
+         } else {
+            x_bottom = xb;
+            sy1 = y_bottom;
+         }
+
+         if (x_top >= 0 && x_bottom >= 0 && x_top < len && x_bottom < len) {
+            // from here on, we don't have to range check x values
+
+            if ((int) x_top == (int) x_bottom) {
+               // simple case, only spans one pixel
+               int x = (int) x_top;
+               float height = sy1 - sy0;
+               scanline[x] += e->direction * (1-((x_top - x) + (x_bottom-x))/2) * height;
+               scanline_fill[x] += e->direction * height; // everything right of this pixel is filled
+            } else {
+               int x,x1,x2;
+               float y_crossing, step, sign, area;
+               // covers 2+ pixels
+               if (x_top > x_bottom) {
+                  // flip scanline vertically; signed area is the same
+                  float t;
+                  sy0 = y_bottom - (sy0 - y_top);
+                  sy1 = y_bottom - (sy1 - y_top);
+                  t = sy0, sy0 = sy1, sy1 = t;
+                  t = x_bottom, x_bottom = x_top, x_top = t;
+                  dx = -dx;
+                  dy = -dy;
+                  t = x0, x0 = xb, xb = t;
+               }
+
+               x1 = (int) x_top;
+               x2 = (int) x_bottom;
+               // compute intersection with y axis at x1+1
+               y_crossing = (x1+1 - x0) * dy + y_top;
+               // if x2 is right at the right edge of x1, y_crossing can blow up
+               if (y_crossing > y_bottom)
+                  y_crossing = y_bottom;
+
+               sign = e->direction;
+               // area of the rectangle covered from y0..y_crossing
+               area = sign * (y_crossing-sy0);
+               // area of the triangle (x_top,y0), (x+1,y0), (x+1,y_crossing)
+               scanline[x1] += area * (1-((x_top - x1)+(x1+1-x1))/2);
+
+               step = sign * dy;
+               for (x = x1+1; x < x2; ++x) {
+                  scanline[x] += area + step/2;
+                  area += step;
+               }
+               y_crossing += dy * (x2 - (x1+1));
+               if (y_crossing > y_bottom)
+                  y_crossing = y_bottom;
+
+               scanline[x2] += area + sign * (1-((x2-x2)+(x_bottom-x2))/2) * (sy1-y_crossing);
+
+               scanline_fill[x2] += sign * (sy1-sy0);
+            }
+         } else {
+            // if edge goes outside of box we're drawing, we require
+            // clipping logic. since this does not match the intended use
+            // of this library, we use a different, very slow brute
+            // force implementation: split the part of the edge inside
+            // each pixel column at the column's left and right sides
+            int x;
+            for (x=0; x < len; ++x) {
+               float y0 = y_top;
+               float x1 = (float) (x);
+               float x2 = (float) (x+1);
+               float x3 = xb;
+               float y3 = y_bottom;
+
+               // x = e->x + e->dx * (y-y_top)
+               // (y-y_top) = (x - e->x) / e->dx
+               // y = (x - e->x) / e->dx + y_top
+               float y1 = (x - x0) / dx + y_top;
+               float y2 = (x+1 - x0) / dx + y_top;
+
+               if (x0 < x1 && x3 > x2) {         // three segments descending down-right
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x1,y1);
+                  stbtt__handle_clipped_edge(scanline,x,e, x1,y1, x2,y2);
+                  stbtt__handle_clipped_edge(scanline,x,e, x2,y2, x3,y3);
+               } else if (x3 < x1 && x0 > x2) {  // three segments descending down-left
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x2,y2);
+                  stbtt__handle_clipped_edge(scanline,x,e, x2,y2, x1,y1);
+                  stbtt__handle_clipped_edge(scanline,x,e, x1,y1, x3,y3);
+               } else if (x0 < x1 && x3 > x1) {  // two segments across x, down-right
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x1,y1);
+                  stbtt__handle_clipped_edge(scanline,x,e, x1,y1, x3,y3);
+               } else if (x3 < x1 && x0 > x1) {  // two segments across x, down-left
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x1,y1);
+                  stbtt__handle_clipped_edge(scanline,x,e, x1,y1, x3,y3);
+               } else if (x0 < x2 && x3 > x2) {  // two segments across x+1, down-right
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x2,y2);
+                  stbtt__handle_clipped_edge(scanline,x,e, x2,y2, x3,y3);
+               } else if (x3 < x2 && x0 > x2) {  // two segments across x+1, down-left
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x2,y2);
+                  stbtt__handle_clipped_edge(scanline,x,e, x2,y2, x3,y3);
+               } else {  // one segment
+                  stbtt__handle_clipped_edge(scanline,x,e, x0,y0, x3,y3);
+               }
+            }
+         }
+      }
+      e = e->next;
+   }
+}
+
+static void stbtt__rasterize_sorted_edges_area(stbtt__bitmap *result, stbtt__edge *e, int n, int off_x, int off_y, void *userdata)
+{
+   stbtt__hheap hh = { 0, 0, 0 };
+   stbtt__area_edge *active = NULL;
+   int y,j=0;
+   float scanline_data[129], *scanline, *scanline2;
+
+   if (result->w > 64)
+      scanline = (float *) STBTT_malloc((unsigned)(result->w*2+1) * sizeof(float), userdata);
+   else
+      scanline = scanline_data;
+
+   // coverage for the row, then accumulated fill carried to the right
+   scanline2 = scanline + result->w;
+
+   y = off_y;
+   e[n].y0 = (float) (off_y + result->h) + 1;
+
+   while (j < result->h) {
+      float scan_y_top    = y + 0.0f;
+      float scan_y_bottom = y + 1.0f;
+      stbtt__area_edge **step = &active;
+
+      STBTT_memset(scanline , 0, (unsigned)result->w*sizeof(scanline[0]));
+      STBTT_memset(scanline2, 0, (unsigned)(result->w+1)*sizeof(scanline[0]));
+
+      // remove all active edges that terminate before the top of this scanline
+      while (*step) {
+         stbtt__area_edge * z = *step;
+         if (z->ey <= scan_y_top) {
+            *step = z->next; // delete from list
+            STBTT_assert(z->direction);
+            z->direction = 0;
+            stbtt__hheap_free(&hh, z);
+         } else {
+            step = &((*step)->next); // advance through list
+         }
+      }
+
+      // insert all edges that start before the bottom of this scanline;
+      // coverage is summed per pixel, so the list needs no ordering
+      while (e->y0 <= scan_y_bottom) {
+         if (e->y0 != e->y1) {
+            stbtt__area_edge *z = stbtt__new_area_edge(&hh, e, off_x, scan_y_top, userdata);
+            if (z != NULL) {
+               // a sliver of an edge can end just above the first row due to rounding
+               if (j == 0 && off_y != 0 && z->ey < scan_y_top)
+                  z->ey = scan_y_top;
+               z->next = active;
+               active = z;
+            }
+         }
+         ++e;
+      }
+
+      if (active)
+         stbtt__fill_area_edges(scanline, scanline2+1, result->w, active, scan_y_top);
+
+      stbtt__kernels()->resolve(scanline, scanline2, result->pixels + j*result->stride, result->w);
+
+      // advance all the edges
+      step = &active;
+      while (*step) {
+         stbtt__area_edge *z = *step;
+         z->fx += z->fdx; // advance to position for current scanline
+         step = &((*step)->next); // advance through list
+      }
+
+      ++y;
+      ++j;
    }
 
+   stbtt__hheap_cleanup(&hh, userdata);
+
    if (scanline != scanline_data)
       STBTT_free(scanline, userdata);
 }
 
-static int stbtt__edge_compare(const void *p, const void *q)
+static void stbtt__sort_edges_ins_sort(stbtt__edge *e, int n)
 {
-   stbtt__edge *a = (stbtt__edge *) p;
-   stbtt__edge *b = (stbtt__edge *) q;
+   int i,j;
+   for (i=1; i < n; ++i) {
+      stbtt__edge t = e[i];
+      j = i;
+      while (j > 0 && e[j-1].y0 > t.y0) {
+         e[j] = e[j-1];
+         --j;
+      }
+      e[j] = t;
+   }
+}
 
-   if (a->y0 < b->y0) return -1;
-   if (a->y0 > b->y0) return  1;
-   return 0;
+// maps a float to an unsigned int with the same ordering, so y can be
+// radix sorted
+static stbtt_uint32 stbtt__edge_key(float y)
+{
+   stbtt_uint32 u;
+   STBTT_memcpy(&u, &y, sizeof(u));
+   return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+// sort the edges by their highest point with a stable LSD radix sort on y,
+// one byte at a time, skipping bytes that are the same for every edge
+static void stbtt__sort_edges(stbtt__edge *e, int n, void *userdata)
+{
+   stbtt__edge *tmp, *src, *dst, *t;
+   int count[256];
+   int i, shift;
+
+   if (n < 32) {
+      stbtt__sort_edges_ins_sort(e, n);
+      return;
+   }
+
+   tmp = (stbtt__edge *) STBTT_malloc(sizeof(*tmp) * (unsigned)n, userdata);
+   if (tmp == NULL) {
+      stbtt__sort_edges_ins_sort(e, n);
+      return;
+   }
+
+   src = e;
+   dst = tmp;
+   for (shift=0; shift < 32; shift += 8) {
+      int sum = 0;
+      STBTT_memset(count, 0, sizeof(count));
+      for (i=0; i < n; ++i)
+         ++count[(stbtt__edge_key(src[i].y0) >> shift) & 255];
+      if (count[(stbtt__edge_key(src[0].y0) >> shift) & 255] == n)
+         continue;
+      for (i=0; i < 256; ++i) {
+         int c = count[i];
+         count[i] = sum;
+         sum += c;
+      }
+      for (i=0; i < n; ++i)
+         dst[count[(stbtt__edge_key(src[i].y0) >> shift) & 255]++] = src[i];
+      t = src, src = dst, dst = t;
+   }
+
+   if (src != e)
+      STBTT_memcpy(e, src, sizeof(*e) * (unsigned)n);
+   STBTT_free(tmp, userdata);
 }
 
 typedef struct
@@ -1343,13 +2043,14 @@ typedef struct
    float x,y;
 } stbtt__point;
 
-static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, int off_x, int off_y, int invert, void *userdata)
+// blows the windings out into an edge list sorted by y, with y scaled by
+// vsubsample; returns NULL if out of memory. the list has room for one
+// more edge after the last, which the rasterizers use as a sentinel
+static stbtt__edge *stbtt__build_edges(stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, int invert, int vsubsample, int *num_edges, void *userdata)
 {
    float y_scale_inv = invert ? -scale_y : scale_y;
    stbtt__edge *e;
    int n,i,j,k,m;
-   int vsubsample = result->h < 8 ? 15 : 5;
-   // vsubsample should divide 255 evenly; otherwise we won't reach full opacity
 
    // now we have to blow out the windings into explicit edge lists
    n = 0;
@@ -1357,7 +2058,7 @@ static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcou
       n += wcount[i];
 
    e = (stbtt__edge *) STBTT_malloc(sizeof(*e) * ((unsigned)n+1), userdata); // add an extra one as a sentinel
-   if (e == 0) return;
+   if (e == 0) return 0;
    n = 0;
 
    m=0;
@@ -1385,55 +2086,171 @@ static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcou
    }
 
    // now sort the edges by their highest point (should snap to integer, and then by x)
-   STBTT_sort(e, (unsigned)n, sizeof(e[0]), stbtt__edge_compare);
+   stbtt__sort_edges(e, n, userdata);
 
-   // now, traverse the scanlines and find the intersections on each scanline, use xor winding rule
-   stbtt__rasterize_sorted_edges(result, e, n, vsubsample, off_x, off_y, userdata);
+   *num_edges = n;
+   return e;
+}
+
+// now, traverse the scanlines and find the intersections on each scanline, use xor winding rule
+static void stbtt__rasterize_edges(stbtt__bitmap *result, stbtt__edge *e, int n, int vsubsample, int version, int off_x, int off_y, void *userdata)
+{
+   if (version == 2)
+      stbtt__rasterize_sorted_edges_area(result, e, n, off_x, off_y, userdata);
+   else
+      stbtt__rasterize_sorted_edges(result, e, n, vsubsample, off_x, off_y, userdata);
+}
+
+static int stbtt__vsubsample(int version, int h)
+{
+   // vsubsample should divide 255 evenly; otherwise we won't reach full opacity
+   return version == 2 ? 1 : h < 8 ? 15 : 5;
+}
+
+static void stbtt__rasterize(stbtt__bitmap *result, stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, int off_x, int off_y, int invert, int version, void *userdata)
+{
+   int vsubsample = stbtt__vsubsample(version, result->h);
+   stbtt__edge *e;
+   int n;
+
+   e = stbtt__build_edges(pts, wcount, windings, scale_x, scale_y, invert, vsubsample, &n, userdata);
+   if (e == 0) return;
+
+   stbtt__rasterize_edges(result, e, n, vsubsample, version, off_x, off_y, userdata);
 
    STBTT_free(e, userdata);
 }
 
-static void stbtt__add_point(stbtt__point *points, int n, float x, float y)
+static int stbtt__is_empty(const unsigned char *p, int w, int h, int stride)
 {
-   if (!points) return; // during first pass, it's unallocated
-   points[n].x = x;
-   points[n].y = y;
+   int i,j;
+   for (j=0; j < h; ++j, p += stride)
+      for (i=0; i < w; ++i)
+         if (p[i])
+            return 0;
+   return 1;
 }
 
-// tesselate until threshhold p is happy... @TODO warped to compensate for non-linear stretching
-static int stbtt__tesselate_curve(stbtt__point *points, int *num_points, float x0, float y0, float x1, float y1, float x2, float y2, float objspace_flatness_squared, int n)
+// rasterizes one row of tiles at a time. each row only looks at the edges
+// that reach into it, so edges that have already ended are never visited
+// again
+static void stbtt__rasterize_tiled(int w, int h, int tile_size, int skip_empty, stbtt__point *pts, int *wcount, int windings, float scale_x, float scale_y, int off_x, int off_y, int invert, stbtt_tile_func *emit, void *ctx, void *userdata)
 {
-   // midpoint
-   float mx = (x0 + 2*x1 + x2)/4;
-   float my = (y0 + 2*y1 + y2)/4;
-   // versus directly drawn line
-   float dx = (x0+x2)/2 - mx;
-   float dy = (y0+y2)/2 - my;
-   if (n > 16) // 65536 segments on one curve better be enough!
-      return 1;
-   if (dx*dx+dy*dy > objspace_flatness_squared) { // half-pixel error allowed... need to be smaller if AA
-      stbtt__tesselate_curve(points, num_points, x0,y0, (x0+x1)/2.0f,(y0+y1)/2.0f, mx,my, objspace_flatness_squared,n+1);
-      stbtt__tesselate_curve(points, num_points, mx,my, (x1+x2)/2.0f,(y1+y2)/2.0f, x2,y2, objspace_flatness_squared,n+1);
-   } else {
-      stbtt__add_point(points, *num_points,x2,y2);
-      *num_points = *num_points+1;
+   int version = STBTT_RASTERIZER_VERSION;
+   int vsubsample = stbtt__vsubsample(version, h);
+   stbtt__edge *e, *band = NULL;
+   stbtt__bitmap strip;
+   int n,m,i,x,y,tw;
+
+   e = stbtt__build_edges(pts, wcount, windings, scale_x, scale_y, invert, vsubsample, &n, userdata);
+   if (e == 0) return;
+   strip.w = strip.stride = w;
+   strip.pixels = (unsigned char *) STBTT_malloc((unsigned)(w*tile_size), userdata);
+   if (strip.pixels)
+      band = (stbtt__edge *) STBTT_malloc(sizeof(*band) * ((unsigned)n+1), userdata);
+
+   if (band) {
+      for (y=0; y < h; y += tile_size) {
+         float top, bottom;
+         strip.h = h-y < tile_size ? h-y : tile_size;
+         top    = (float) ((off_y + y) * vsubsample);
+         bottom = (float) ((off_y + y + strip.h) * vsubsample);
+
+         // keep the edges that overlap this row of tiles; they stay sorted
+         for (i=m=0; i < n; ++i)
+            if (e[i].y1 > top && e[i].y0 <= bottom)
+               band[m++] = e[i];
+
+         if (m)
+            stbtt__rasterize_edges(&strip, band, m, vsubsample, version, off_x, off_y + y, userdata);
+         else if (skip_empty)
+            continue;
+         else
+            STBTT_memset(strip.pixels, 0, (unsigned)(w*strip.h));
+
+         for (x=0; x < w; x += tile_size) {
+            tw = w-x < tile_size ? w-x : tile_size;
+            if (!skip_empty || !stbtt__is_empty(strip.pixels + x, tw, strip.h, w))
+               emit(ctx, x, y, tw, strip.h, strip.pixels + x, w);
+         }
+      }
+      STBTT_free(band, userdata);
    }
-   return 1;
+
+   STBTT_free(strip.pixels, userdata);
+   STBTT_free(e, userdata);
+}
+
+// number of times a curve must be halved before each piece is within the
+// flatness tolerance of its chord. halving a quadratic bezier divides the
+// distance from its midpoint to its chord by 4, equally for both halves, so
+// subdividing always ends in 2^n equal pieces and n can be found up front.
+static int stbtt__curve_subdivisions(float x0, float y0, float x1, float y1, float x2, float y2, float objspace_flatness_squared)
+{
+   // midpoint versus directly drawn line
+   float dx = (x0 - 2*x1 + x2)/4;
+   float dy = (y0 - 2*y1 + y2)/4;
+   float dd = dx*dx + dy*dy;
+   int n = 0;
+   while (dd > objspace_flatness_squared && n < 16) { // 65536 segments on one curve better be enough!
+      dd *= 1.0f/16;
+      ++n;
+   }
+   return n;
+}
+
+// writes the end points of the curve's 2^n pieces, not including its start,
+// by forward differencing; returns the point after the last one written
+static stbtt__point *stbtt__tesselate_curve(stbtt__point *p, float x0, float y0, float x1, float y1, float x2, float y2, int n)
+{
+   int i, count = 1 << n;
+   float h = 1.0f / (float) count;
+   float ax = (x0 - 2*x1 + x2)*h*h, ay = (y0 - 2*y1 + y2)*h*h;
+   float dx = 2*(x1 - x0)*h + ax, dy = 2*(y1 - y0)*h + ay;
+   float x = x0, y = y0;
+   for (i=1; i < count; ++i) {
+      x += dx;
+      y += dy;
+      dx += 2*ax;
+      dy += 2*ay;
+      p->x = x;
+      p->y = y;
+      ++p;
+   }
+   // end exactly on the end point, whatever rounding did above
+   p->x = x2;
+   p->y = y2;
+   return p+1;
 }
 
 // returns number of contours
-inline stbtt__point *stbtt_FlattenCurves(stbtt_vertex *vertices, int num_verts, float objspace_flatness, int **contour_lengths, int *num_contours, void* /*userdata*/)
+inline stbtt__point *stbtt_FlattenCurves(stbtt_vertex *vertices, int num_verts, float objspace_flatness, int **contour_lengths, int *num_contours, void *userdata)
 {
-   stbtt__point *points=0;
+   stbtt__point *points=0, *p;
    int num_points=0;
 
    float objspace_flatness_squared = objspace_flatness * objspace_flatness;
-   int i,n=0,start=0, pass;
-
-   // count how many "moves" there are to get the contour count
-   for (i=0; i < num_verts; ++i)
-      if (vertices[i].type == STBTT_vmove)
-         ++n;
+   float x=0,y=0;
+   int i,n=0,start=0;
+
+   // count how many "moves" there are to get the contour count, and how
+   // many points each vertex makes so they can be written in a single pass
+   for (i=0; i < num_verts; ++i) {
+      switch (vertices[i].type) {
+         case STBTT_vmove:
+            ++n;
+            ++num_points;
+            break;
+         case STBTT_vline:
+            ++num_points;
+            break;
+         case STBTT_vcurve:
+            num_points += 1 << stbtt__curve_subdivisions(x,y, vertices[i].cx, vertices[i].cy, vertices[i].x, vertices[i].y,
+                                                         objspace_flatness_squared);
+            break;
+      }
+      x = vertices[i].x, y = vertices[i].y;
+   }
 
    *num_contours = n;
    if (n == 0) return 0;
@@ -1445,42 +2262,40 @@ inline stbtt__point *stbtt_FlattenCurves(stbtt_vertex *vertices, int num_verts,
       return 0;
    }
 
-   // make two passes through the points so we don't need to realloc
-   for (pass=0; pass < 2; ++pass) {
-      float x=0,y=0;
-      if (pass == 1) {
-         points = (stbtt__point *) STBTT_malloc((unsigned)num_points * sizeof(points[0]), userdata);
-         if (points == NULL) goto error;
-      }
-      num_points = 0;
-      n= -1;
-      for (i=0; i < num_verts; ++i) {
-         switch (vertices[i].type) {
-            case STBTT_vmove:
-               // start the next contour
-               if (n >= 0)
-                  (*contour_lengths)[n] = num_points - start;
-               ++n;
-               start = num_points;
-
-               x = vertices[i].x, y = vertices[i].y;
-               stbtt__add_point(points, num_points++, x,y);
-               break;
-            case STBTT_vline:
-               x = vertices[i].x, y = vertices[i].y;
-               stbtt__add_point(points, num_points++, x, y);
-               break;
-            case STBTT_vcurve:
-               stbtt__tesselate_curve(points, &num_points, x,y,
-                                        vertices[i].cx, vertices[i].cy,
-                                        vertices[i].x,  vertices[i].y,
-                                        objspace_flatness_squared, 0);
-               x = vertices[i].x, y = vertices[i].y;
-               break;
-         }
+   points = (stbtt__point *) STBTT_malloc((unsigned)num_points * sizeof(points[0]), userdata);
+   if (points == NULL) goto error;
+
+   p = points;
+   n = -1;
+   for (i=0; i < num_verts; ++i) {
+      switch (vertices[i].type) {
+         case STBTT_vmove:
+            // start the next contour
+            if (n >= 0)
+               (*contour_lengths)[n] = (int) (p - points) - start;
+            ++n;
+            start = (int) (p - points);
+
+            x = vertices[i].x, y = vertices[i].y;
+            p->x = x, p->y = y;
+            ++p;
+            break;
+         case STBTT_vline:
+            x = vertices[i].x, y = vertices[i].y;
+            p->x = x, p->y = y;
+            ++p;
+            break;
+         case STBTT_vcurve:
+            p = stbtt__tesselate_curve(p, x,y,
+                                       vertices[i].cx, vertices[i].cy,
+                                       vertices[i].x,  vertices[i].y,
+                                       stbtt__curve_subdivisions(x,y, vertices[i].cx, vertices[i].cy, vertices[i].x, vertices[i].y,
+                                                                 objspace_flatness_squared));
+            x = vertices[i].x, y = vertices[i].y;
+            break;
       }
-      (*contour_lengths)[n] = num_points - start;
    }
+   (*contour_lengths)[n] = (int) (p - points) - start;
 
    return points;
 error:
@@ -1491,19 +2306,159 @@ error:
    return NULL;
 }
 
-void stbtt_Rasterize(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, void *userdata)
+void stbtt_RasterizeWithVersion(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, int version, void *userdata)
 {
    float scale = scale_x > scale_y ? scale_y : scale_x;
    int winding_count, *winding_lengths;
    stbtt__point *windings = stbtt_FlattenCurves(vertices, num_verts, flatness_in_pixels / scale, &winding_lengths, &winding_count, userdata);
    if (windings) {
-      stbtt__rasterize(result, windings, winding_lengths, winding_count, scale_x, scale_y, x_off, y_off, invert, userdata);
+      stbtt__rasterize(result, windings, winding_lengths, winding_count, scale_x, scale_y, x_off, y_off, invert, version, userdata);
       STBTT_free(winding_lengths, userdata);
       STBTT_free(windings, userdata);
    }
 }
 
-void stbtt_FreeBitmap(unsigned char *bitmap, void* /*userdata*/)
+void stbtt_RasterizeTiled(int w, int h, int tile_size, int skip_empty, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, stbtt_tile_func *emit, void *ctx, void *userdata)
+{
+   float scale = scale_x > scale_y ? scale_y : scale_x;
+   int winding_count, *winding_lengths;
+   stbtt__point *windings;
+   if (w <= 0 || h <= 0 || tile_size <= 0)
+      return;
+   windings = stbtt_FlattenCurves(vertices, num_verts, flatness_in_pixels / scale, &winding_lengths, &winding_count, userdata);
+   if (windings) {
+      stbtt__rasterize_tiled(w, h, tile_size, skip_empty, windings, winding_lengths, winding_count, scale_x, scale_y, x_off, y_off, invert, emit, ctx, userdata);
+      STBTT_free(winding_lengths, userdata);
+      STBTT_free(windings, userdata);
+   }
+}
+
+void stbtt_Rasterize(stbtt__bitmap *result, float flatness_in_pixels, stbtt_vertex *vertices, int num_verts, float scale_x, float scale_y, int x_off, int y_off, int invert, void *userdata)
+{
+   stbtt_RasterizeWithVersion(result, flatness_in_pixels, vertices, num_verts, scale_x, scale_y, x_off, y_off, invert, STBTT_RASTERIZER_VERSION, userdata);
+}
+
+static void stbtt__sort_floats(float *v, int n)
+{
+   // shell sort; a glyph has a few thousand heights at most
+   static const int gaps[] = { 701, 301, 132, 57, 23, 10, 4, 1 };
+   int g,i,j;
+   for (g=0; g < 8; ++g) {
+      int gap = gaps[g];
+      for (i=gap; i < n; ++i) {
+         float t = v[i];
+         for (j=i; j >= gap && v[j-gap] > t; j -= gap)
+            v[j] = v[j-gap];
+         v[j] = t;
+      }
+   }
+}
+
+static float stbtt__edge_x(const stbtt__edge *e, float y)
+{
+   return e->x0 + (y - e->y0) * (e->x1 - e->x0) / (e->y1 - e->y0);
+}
+
+// cuts the inside into one trapezoid per span between each pair of
+// consecutive heights in ys, and writes them as two triangles each to 'out'
+// unless it is NULL; returns the triangle count. every edge starts and ends
+// on one of the heights, so within a band the active edges do not change
+static int stbtt__trapezoids(stbtt__edge *e, int n, const float *ys, int nys, int *act, float *out)
+{
+   int i,j,k,m=0,next=0,w,left=0,count=0;
+   for (i=0; i+1 < nys; ++i) {
+      float ya = ys[i], yb = ys[i+1], ym = (ya + yb) / 2;
+
+      // drop the edges that ended, add the ones that start here
+      for (j=k=0; j < m; ++j)
+         if (e[act[j]].y1 > ya)
+            act[k++] = act[j];
+      m = k;
+      for (; next < n && e[next].y0 <= ya; ++next)
+         if (e[next].y1 > ya)
+            act[m++] = next;
+
+      // order by x in the middle of the band; insertion sort, as the order
+      // hardly changes from one band to the next
+      for (j=1; j < m; ++j) {
+         int t = act[j];
+         float tx = stbtt__edge_x(&e[t], ym);
+         for (k=j; k > 0 && stbtt__edge_x(&e[act[k-1]], ym) > tx; --k)
+            act[k] = act[k-1];
+         act[k] = t;
+      }
+
+      w = 0;
+      for (j=0; j < m; ++j) {
+         if (w == 0)
+            left = act[j];
+         w += e[act[j]].invert ? 1 : -1;
+         if (w == 0) {
+            if (out) {
+               float xa0 = stbtt__edge_x(&e[left], ya), xa1 = stbtt__edge_x(&e[act[j]], ya);
+               float xb0 = stbtt__edge_x(&e[left], yb), xb1 = stbtt__edge_x(&e[act[j]], yb);
+               out[ 0] = xa0, out[ 1] = ya, out[ 2] = xa1, out[ 3] = ya, out[ 4] = xb1, out[ 5] = yb;
+               out[ 6] = xa0, out[ 7] = ya, out[ 8] = xb1, out[ 9] = yb, out[10] = xb0, out[11] = yb;
+               out += 12;
+            }
+            count += 2;
+         }
+      }
+   }
+   return count;
+}
+
+int stbtt_TessellateShape(stbtt_vertex *vertices, int num_verts, float objspace_flatness, float **triangles, void *userdata)
+{
+   int winding_count, *winding_lengths, n=0, nys, i, count=0;
+   stbtt__point *windings;
+   stbtt__edge *e;
+   float *ys = 0;
+   int *act = 0;
+
+   *triangles = 0;
+   windings = stbtt_FlattenCurves(vertices, num_verts, objspace_flatness, &winding_lengths, &winding_count, userdata);
+   if (windings == 0)
+      return 0;
+
+   e = stbtt__build_edges(windings, winding_lengths, winding_count, 1, 1, 0, 1, &n, userdata);
+   if (e && n) {
+      ys = (float *) STBTT_malloc(sizeof(*ys) * (unsigned)(n*2), userdata);
+      act = (int *) STBTT_malloc(sizeof(*act) * (unsigned)n, userdata);
+   }
+   if (ys && act) {
+      for (i=0; i < n; ++i) {
+         ys[i*2+0] = e[i].y0;
+         ys[i*2+1] = e[i].y1;
+      }
+      stbtt__sort_floats(ys, n*2);
+      for (i=nys=1; i < n*2; ++i)
+         if (ys[i] != ys[nys-1])
+            ys[nys++] = ys[i];
+
+      count = stbtt__trapezoids(e, n, ys, nys, act, NULL);
+      if (count)
+         *triangles = (float *) STBTT_malloc(sizeof(**triangles) * (unsigned)(count*6), userdata);
+      if (*triangles)
+         stbtt__trapezoids(e, n, ys, nys, act, *triangles);
+      else
+         count = 0;
+   }
+
+   STBTT_free(act, userdata);
+   STBTT_free(ys, userdata);
+   STBTT_free(e, userdata);
+   STBTT_free(winding_lengths, userdata);
+   STBTT_free(windings, userdata);
+   return count;
+}
+
+void stbtt_FreeTriangles(float *triangles, void *userdata)
+{
+   STBTT_free(triangles, userdata);
+}
+
+void stbtt_FreeBitmap(unsigned char *bitmap, void *userdata)
 {
    STBTT_free(bitmap, userdata);
 }
@@ -1545,11 +2500,9 @@ unsigned char *stbtt_GetGlyphBitmap(const stbtt_fontinfo *info, float scale_x, f
    return gbm.pixels;
 }
 
-void stbtt_MakeGlyphBitmap(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph)
+void stbtt_MakeGlyphBitmapFromShape(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph, stbtt_vertex *vertices, int num_verts)
 {
    int ix0,iy0;
-   stbtt_vertex *vertices;
-   int num_verts = stbtt_GetGlyphShape(info, glyph, &vertices);
    stbtt__bitmap gbm;
 
    stbtt_GetGlyphBitmapBox(info, glyph, scale_x, scale_y, &ix0,&iy0,0,0);
@@ -1560,10 +2513,35 @@ void stbtt_MakeGlyphBitmap(const stbtt_fontinfo *info, unsigned char *output, in
 
    if (gbm.w && gbm.h)
       stbtt_Rasterize(&gbm, 0.35f, vertices, num_verts, scale_x, scale_y, ix0,iy0, 1, info->userdata);
+}
+
+void stbtt_MakeGlyphBitmap(const stbtt_fontinfo *info, unsigned char *output, int out_w, int out_h, int out_stride, float scale_x, float scale_y, int glyph)
+{
+   stbtt_vertex *vertices;
+   int num_verts = stbtt_GetGlyphShape(info, glyph, &vertices);
+
+   stbtt_MakeGlyphBitmapFromShape(info, output, out_w, out_h, out_stride, scale_x, scale_y, glyph, vertices, num_verts);
 
    STBTT_free(vertices, info->userdata);
 }
 
+void stbtt_MakeGlyphBitmaps(const stbtt_fontinfo *info, unsigned char *output, int out_stride, const stbtt_glyphjob *jobs, int num_jobs)
+{
+   int i;
+   for (i=0; i < num_jobs; ++i) {
+      const stbtt_glyphjob *j = &jobs[i];
+      unsigned char *p = output + j->y*out_stride + j->x;
+      if (j->vertices)
+         stbtt_MakeGlyphBitmapFromShape(info, p, j->w, j->h, out_stride, j->scale_x, j->scale_y, j->glyph, j->vertices, j->num_verts);
+      else
+         stbtt_MakeGlyphBitmap(info, p, j->w, j->h, out_stride, j->scale_x, j->scale_y, j->glyph);
+      #ifdef STBTT_ARENA
+      if (info->userdata)
+         stbtt_ArenaReset((stbtt_arena *) info->userdata);
+      #endif
+   }
+}
+
 unsigned char *stbtt_GetCodepointBitmap(const stbtt_fontinfo *info, float scale_x, float scale_y, int codepoint, int *width, int *height, int *xoff, int *yoff)
 {
    return stbtt_GetGlyphBitmap(info, scale_x, scale_y, stbtt_FindGlyphIndex(info,codepoint), width,height,xoff,yoff);
@@ -1574,6 +2552,99 @@ void stbtt_MakeCodepointBitmap(const stbtt_fontinfo *info, unsigned char *output
    stbtt_MakeGlyphBitmap(info, output, out_w, out_h, out_stride, scale_x, scale_y, stbtt_FindGlyphIndex(info,codepoint));
 }
 
+#ifdef STBTT_ARENA
+//////////////////////////////////////////////////////////////////////////////
+//
+// scratch arena
+//
+
+typedef struct stbtt__arena_block
+{
+   struct stbtt__arena_block *next;
+} stbtt__arena_block;
+
+// keep payloads 16-byte aligned, both in the base block and in overflow blocks
+#define STBTT__ARENA_ALIGN(x)   (((x) + 15) & ~(size_t) 15)
+#define STBTT__ARENA_HEADER     STBTT__ARENA_ALIGN(sizeof(stbtt__arena_block))
+
+void stbtt_ArenaInit(stbtt_arena *arena, unsigned int size)
+{
+   STBTT_memset(arena, 0, sizeof(*arena));
+   if (size) {
+      arena->base = (unsigned char *) malloc(size);
+      if (arena->base) {
+         arena->size = size;
+         arena->heap_allocs = 1;
+      }
+   }
+}
+
+void *stbtt_ArenaAlloc(stbtt_arena *arena, size_t size)
+{
+   stbtt__arena_block *b;
+   size = STBTT__ARENA_ALIGN(size);
+   if (arena == NULL)
+      return malloc(size);
+
+   if (size <= arena->size - arena->used) {
+      void *p = arena->base + arena->used;
+      arena->used += (unsigned int) size;
+      return p;
+   }
+
+   // doesn't fit; borrow from the heap until the next reset grows the arena
+   b = (stbtt__arena_block *) malloc(STBTT__ARENA_HEADER + size);
+   if (b == NULL)
+      return NULL;
+   b->next = (stbtt__arena_block *) arena->overflow;
+   arena->overflow = b;
+   arena->overflow_size += (unsigned int) size;
+   ++arena->heap_allocs;
+   return (unsigned char *) b + STBTT__ARENA_HEADER;
+}
+
+void stbtt_ArenaFree(stbtt_arena *arena, void *p)
+{
+   // arena memory is reclaimed all at once by stbtt_ArenaReset
+   if (arena == NULL)
+      free(p);
+}
+
+void stbtt_ArenaReset(stbtt_arena *arena)
+{
+   stbtt__arena_block *b = (stbtt__arena_block *) arena->overflow;
+   if (b) {
+      unsigned int size = arena->used + arena->overflow_size;
+      if (size < arena->size * 2)
+         size = arena->size * 2;
+      while (b) {
+         stbtt__arena_block *next = b->next;
+         free(b);
+         b = next;
+      }
+      free(arena->base);
+      arena->base = (unsigned char *) malloc(size);
+      arena->size = arena->base ? size : 0;
+      ++arena->heap_allocs;
+      arena->overflow = NULL;
+      arena->overflow_size = 0;
+   }
+   arena->used = 0;
+}
+
+void stbtt_ArenaRelease(stbtt_arena *arena)
+{
+   stbtt__arena_block *b = (stbtt__arena_block *) arena->overflow;
+   while (b) {
+      stbtt__arena_block *next = b->next;
+      free(b);
+      b = next;
+   }
+   free(arena->base);
+   STBTT_memset(arena, 0, sizeof(*arena));
+}
+#endif // STBTT_ARENA
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // bitmap baking
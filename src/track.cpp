@@ -0,0 +1,126 @@
+#include "track.h"
+#include "loop.h"
+
+#include <algorithm>
+#include <utility>
+
+static void unlink(std::vector<Cell*>& cells, Cell* cell) {
+  auto it = std::find(cells.begin(), cells.end(), cell);
+  if (it == cells.end()) return;
+  *it = cells.back();
+  cells.pop_back();
+}
+
+Cell::~Cell() {
+  for (Cell* var: reads)
+    unlink(var->readers, this);
+  for (Cell* reader: readers)
+    unlink(reader->reads, this);
+  if (dirty) currentGraph().forget(this);
+}
+
+Graph& currentGraph() {
+  static thread_local Graph graph;
+  return graph;
+}
+
+void Graph::read(Cell* var) {
+  Cell* cell = current;
+  if (!cell) return;
+  if (std::find(cell->reads.begin(), cell->reads.end(), var) != cell->reads.end()) return;
+  cell->reads.push_back(var);
+  var->readers.push_back(cell);
+  if (var->level >= cell->level) raise(cell, var->level + 1);
+}
+
+// Moves a computing cell, its var and everything reading that var above
+// 'level' as needed, so readers still come after what they read. Only a new
+// read by 'cell' can close a cycle, and then the raise comes back around to
+// it; it is not raised again, as no level can be above everything it reads.
+void Graph::raise(Cell* cell, int level) {
+  std::vector<std::pair<Cell*, int>> work(1, std::make_pair(cell, level));
+  while (!work.empty()) {
+    Cell* c = work.back().first;
+    int l = work.back().second;
+    work.pop_back();
+    if (c->level >= l) continue;
+    c->level = l;
+    Cell* var = c->writes;
+    if (!var) continue;
+    var->level = l;
+    for (Cell* reader: var->readers)
+      if (reader != cell) work.push_back(std::make_pair(reader, l + 1));
+  }
+}
+
+void Graph::mark(Cell* cell) {
+  size_t level = static_cast<size_t>(cell->level);
+  if (dirty.size() <= level) dirty.resize(level + 1);
+  dirty[level].push_back(cell);
+}
+
+void Graph::changed(Cell* var) {
+  for (Cell* reader: var->readers) {
+    if (reader->dirty) continue;
+    reader->dirty = true;
+    mark(reader);
+  }
+  // Vars computed during the pass are part of it.
+  if (stabilizing) return;
+  ++invalidations;
+  ++pending;
+  if (frameMs <= 0) {
+    endFrame();
+  } else if (!frameQueued) {
+    frameQueued = true;
+    int ms = frameMs - static_cast<int>(nowMs() % static_cast<std::uint64_t>(frameMs));
+    currentLoop().addTimer(ms, [this] () { endFrame(); });
+  }
+}
+
+void Graph::endFrame() {
+  frameQueued = false;
+  if (!pending) return;
+  pending = 0;
+  Arena& arena = frameArena();
+  bool arenaOn = useArena;
+  if (arenaOn) ++arena.active;
+  stabilize();
+  ++frames;
+  if (render) render();
+  if (arenaOn && --arena.active == 0) arena.reset();
+}
+
+void Graph::stabilize() {
+  stabilizing = true;
+  for (size_t level = 0; level < dirty.size(); ++level) {
+    while (!dirty[level].empty()) {
+      Cell* cell = dirty[level].back();
+      dirty[level].pop_back();
+      // Raised since it was marked; it is run at its new level instead.
+      if (static_cast<size_t>(cell->level) > level) {
+        mark(cell);
+        continue;
+      }
+      cell->dirty = false;
+      recompute(cell);
+    }
+  }
+  stabilizing = false;
+}
+
+void Graph::recompute(Cell* cell) {
+  for (Cell* var: cell->reads)
+    unlink(var->readers, cell);
+  cell->reads.clear();
+  Cell* saved = current;
+  current = cell;
+  cell->compute();
+  current = saved;
+  ++recomputed;
+}
+
+void Graph::forget(Cell* cell) {
+  for (std::vector<Cell*>& cells: dirty)
+    unlink(cells, cell);
+}
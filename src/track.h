@@ -0,0 +1,137 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include "ex.h"
+
+#include <memory>
+#include <vector>
+
+// A node of the dependency graph. Vars are cells holding a value; track()
+// adds a cell that computes one var from others. Evaluating a getter inside
+// a computing cell records each var it reads, so when a var changes only the
+// cells that read it are recomputed, lowest level first: a cell's level is
+// above that of every var it read, so each runs once per change, after all
+// of its inputs are up to date.
+struct Cell {
+  int level = 0;
+  bool dirty = false;
+  Cell* writer = nullptr;     // for a var, the cell computing it
+  Cell* writes = nullptr;     // for a computing cell, its var
+  std::vector<Cell*> readers; // for a var, the cells that read it
+  std::vector<Cell*> reads;   // for a computing cell, the vars read last time
+  Cell() = default;
+  Cell(Cell const&) = delete;
+  Cell& operator=(Cell const&) = delete;
+  virtual ~Cell();
+  virtual void compute() {}
+};
+
+// With frameMs set, changes made during a frame are only collected; at the
+// next frame boundary the loop brings everything up to date in one pass and
+// calls render once. Otherwise that happens after every change. Both run with
+// the frame arena active, unless useArena is off, and reset it after.
+struct Graph {
+  std::vector<std::vector<Cell*>> dirty; // by level
+  Cell* current = nullptr;
+  bool stabilizing = false;
+  int frameMs = 0;
+  bool frameQueued = false;
+  long pending = 0; // changes since the last frame
+  F<void ()> render;
+  bool useArena = true;
+  long invalidations = 0;
+  long recomputed = 0;
+  long frames = 0;
+
+  // Records var as read by the cell being computed, if any.
+  void read(Cell* var);
+  // Marks the readers of var for recomputation, and ends the frame or
+  // schedules its end.
+  void changed(Cell* var);
+  void endFrame();
+  void stabilize();
+  void recompute(Cell* cell);
+  void forget(Cell* cell);
+
+private:
+  void mark(Cell* cell);
+  void raise(Cell* cell, int level);
+};
+
+Graph& currentGraph();
+
+// Whether two values are known to be the same. Values with no == never are,
+// so setting one always counts as a change.
+template <typename T, typename = void> struct Comparable: std::false_type {};
+template <typename T>
+struct Comparable<T, typename ToVoid<decltype(std::declval<T const&>() == std::declval<T const&>())>::Type>
+    : std::true_type {};
+
+template <typename T> bool sameValue(T const& a, T const& b, std::true_type) { return a == b; }
+template <typename T> bool sameValue(T const&, T const&, std::false_type) { return false; }
+
+template <typename T> struct VarCell: Cell {
+  T value;
+  std::unique_ptr<Cell> owned; // the writer
+  explicit VarCell(T const& v): value(v) {}
+  void assign(T const& v) {
+    if (sameValue(v, value, Comparable<T>())) return;
+    value = v;
+    currentGraph().changed(this);
+  }
+};
+
+// A value that can be read as an expression, recording the dependency, and
+// changed with set(). Copies share the value.
+template <typename T> struct Var {
+  using Type = T;
+  std::shared_ptr<VarCell<T>> cell;
+  explicit Var(T const& v = T()): cell(std::make_shared<VarCell<T>>(v)) {}
+  T const& peek() const { return cell->value; }
+  void set(T const& v) const { cell->assign(v); }
+  template <typename K> void operator()(K const& k) const {
+    currentGraph().read(cell.get());
+    k(cell->value);
+  }
+};
+
+// A getter. It is an expression itself, so it can be tracked or read from
+// other getters.
+template <typename E> struct Val {
+  using T = typename E::Type;
+  using Type = T;
+  Ex<T> get;
+  template <typename X> Val(X const& x): get(x) {}
+  template <typename K> void operator()(K const& k) const { get(k); }
+};
+
+template <typename T> struct IsExpr<Var<T>>: std::true_type {};
+template <typename E> struct IsExpr<Val<E>>: std::true_type {};
+
+template <typename T> struct TrackCell: Cell {
+  Ex<T> get;
+  explicit TrackCell(Ex<T> get_): get(std::move(get_)) {}
+  // Getters are run to completion here, so they must not wait on the loop.
+  void compute() override { static_cast<VarCell<T>*>(writes)->assign(evalSync(get)); }
+};
+
+template <typename T> struct Track {
+  Var<T> target;
+  Ex<T> get;
+  template <typename K> void operator()(K const& k) const {
+    VarCell<T>* var = target.cell.get();
+    TrackCell<T>* cell = new TrackCell<T>(get);
+    cell->writes = var;
+    var->owned.reset(cell);
+    var->writer = cell;
+    currentGraph().recompute(cell);
+    k();
+  }
+};
+
+// Keeps target equal to what val evaluates to, from now on.
+template <typename T, typename E> Node<void, Track<T>> track(Var<T> target, E const& val) {
+  return {Track<T>{target, Ex<T>(val)}};
+}
+
+#endif // TRACK_H
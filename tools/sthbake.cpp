@@ -0,0 +1,440 @@
+//
+// Bakes glyphs into an atlas that a stash can adopt with sth_add_baked(),
+// so that fixed UI text needs no rasterization at startup.
+//
+// Usage: sthbake [-w width] [-h height] [-n name] -o output
+//                -f slot font [-s size,...] [-t text] [-r first-last] ...
+//
+// Options are applied in order: -f selects the font slot the following
+// glyphs belong to (the index later passed to sth_add_font), -s sets the
+// sizes they are baked at, and each -t (UTF-8 text) or -r (hex code point
+// range) bakes its characters at those sizes. The output is the binary atlas,
+// or C++ source defining 'const unsigned char name[]' and 'const int
+// name_size' when its name ends in ".cpp".
+//
+// Glyphs are placed with the same shelf packer and rasterized with the same
+// calls as fontstash does at runtime, so baked text is pixel identical.
+//
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "../src/stb_truetype.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_ROWS 128
+#define MAX_SIZES 32
+#define MAX_FONTS 64
+#define BAKED_VERSION 2
+
+struct bake_row
+{
+	int x,y,h;
+};
+
+struct bake_glyph
+{
+	unsigned int codepoint;
+	int slot;
+	short size;
+	int x0,y0,x1,y1;
+	float xadv,xoff,yoff;
+};
+
+struct bake_font
+{
+	unsigned char* data;
+	stbtt_fontinfo font;
+};
+
+struct baker
+{
+	int w,h;
+	unsigned char* pixels;
+	struct bake_row rows[MAX_ROWS];
+	int nrows;
+	struct bake_glyph* glyphs;
+	int nglyphs, cglyphs;
+	struct bake_font fonts[MAX_FONTS];
+	int slot;
+	short sizes[MAX_SIZES];
+	int nsizes;
+};
+
+static unsigned char* read_file(const char* path)
+{
+	FILE* fp;
+	unsigned char* data;
+	long size;
+
+	fp = fopen(path, "rb");
+	if (!fp) return NULL;
+	fseek(fp,0,SEEK_END);
+	size = ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	data = (unsigned char*)malloc((size_t)size);
+	if (data && fread(data, 1, (size_t)size, fp) != (size_t)size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	return data;
+}
+
+// Same as alloc_rect() in fontstash.cpp.
+static int alloc_rect(struct baker* b, int w, int h, int* x, int* y)
+{
+	int i, rh;
+	struct bake_row* br;
+
+	br = NULL;
+	rh = (h+7) & ~7;
+	for (i = 0; i < b->nrows; ++i)
+	{
+		if (b->rows[i].h == rh && b->rows[i].x+w+1 <= b->w)
+			br = &b->rows[i];
+	}
+
+	if (br == NULL)
+	{
+		int py = 0;
+		if (b->nrows)
+		{
+			py = b->rows[b->nrows-1].y + b->rows[b->nrows-1].h+1;
+			if (py+rh > b->h)
+				return 0;
+		}
+		if (b->nrows == MAX_ROWS)
+			return 0;
+		br = &b->rows[b->nrows];
+		br->x = 0;
+		br->y = py;
+		br->h = rh;
+		b->nrows++;
+	}
+
+	*x = br->x;
+	*y = br->y;
+	br->x += w+1;
+
+	return 1;
+}
+
+static int bake_glyph(struct baker* b, unsigned int codepoint, short isize)
+{
+	struct bake_font* f = &b->fonts[b->slot];
+	struct bake_glyph* glyph;
+	int i, g, advance, lsb, x0, y0, x1, y1, gx = 0, gy = 0;
+	float size = isize/10.0f;
+	float scale;
+
+	for (i = 0; i < b->nglyphs; ++i)
+	{
+		glyph = &b->glyphs[i];
+		if (glyph->codepoint == codepoint && glyph->slot == b->slot && glyph->size == isize)
+			return 1;
+	}
+
+	scale = stbtt_ScaleForPixelHeight(&f->font, size);
+	g = stbtt_FindGlyphIndex(&f->font, (int)codepoint);
+	stbtt_GetGlyphHMetrics(&f->font, g, &advance, &lsb);
+	stbtt_GetGlyphBitmapBox(&f->font, g, scale,scale, &x0,&y0,&x1,&y1);
+	if (!alloc_rect(b, x1-x0, y1-y0, &gx, &gy))
+	{
+		fprintf(stderr, "Atlas is full at U+%04X size %.1f.\n", codepoint, (double)size);
+		return 0;
+	}
+	stbtt_MakeGlyphBitmap(&f->font, b->pixels + gy*b->w + gx, x1-x0, y1-y0, b->w, scale, scale, g);
+
+	if (b->nglyphs == b->cglyphs)
+	{
+		b->cglyphs = b->cglyphs ? b->cglyphs*2 : 256;
+		b->glyphs = (struct bake_glyph*)realloc(b->glyphs, (size_t)b->cglyphs*sizeof(struct bake_glyph));
+		if (!b->glyphs) return 0;
+	}
+	glyph = &b->glyphs[b->nglyphs++];
+	glyph->codepoint = codepoint;
+	glyph->slot = b->slot;
+	glyph->size = isize;
+	glyph->x0 = gx;
+	glyph->y0 = gy;
+	glyph->x1 = gx + x1-x0;
+	glyph->y1 = gy + y1-y0;
+	glyph->xadv = scale * advance;
+	glyph->xoff = (float)x0;
+	glyph->yoff = (float)y0;
+
+	return 1;
+}
+
+static int bake_codepoint(struct baker* b, unsigned int codepoint)
+{
+	int i;
+	if (!b->fonts[b->slot].data)
+	{
+		fprintf(stderr, "No font selected, use -f first.\n");
+		return 0;
+	}
+	for (i = 0; i < b->nsizes; ++i)
+		if (!bake_glyph(b, codepoint, b->sizes[i])) return 0;
+	return 1;
+}
+
+static int bake_text(struct baker* b, const char* s)
+{
+	const unsigned char* p = (const unsigned char*)s;
+	unsigned int c;
+	int n;
+
+	while (*p)
+	{
+		if (*p < 0x80) { c = *p; n = 0; }
+		else if ((*p & 0xe0) == 0xc0) { c = *p & 0x1fu; n = 1; }
+		else if ((*p & 0xf0) == 0xe0) { c = *p & 0x0fu; n = 2; }
+		else if ((*p & 0xf8) == 0xf0) { c = *p & 0x07u; n = 3; }
+		else { ++p; continue; }
+		for (++p; n > 0 && (*p & 0xc0) == 0x80; --n, ++p)
+			c = (c << 6) | (*p & 0x3fu);
+		if (n == 0 && !bake_codepoint(b, c)) return 0;
+	}
+	return 1;
+}
+
+static int parse_sizes(struct baker* b, const char* s)
+{
+	char* end;
+	b->nsizes = 0;
+	while (*s && b->nsizes < MAX_SIZES)
+	{
+		float size = strtof(s, &end);
+		if (end == s || size <= 0.0f) return 0;
+		b->sizes[b->nsizes++] = (short)(size*10.0f);
+		s = *end == ',' ? end+1 : end;
+	}
+	return b->nsizes > 0;
+}
+
+static void put16(unsigned char* p, unsigned int v)
+{
+	p[0] = (unsigned char)(v & 0xff);
+	p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static void put32(unsigned char* p, unsigned int v)
+{
+	put16(p, v & 0xffff);
+	put16(p+2, v >> 16);
+}
+
+static void putf32(unsigned char* p, float f)
+{
+	unsigned int u;
+	memcpy(&u, &f, sizeof(u));
+	put32(p, u);
+}
+
+// Lays out the atlas in the format sth_add_baked() reads. Only the rows in
+// use are kept, and each font used gets a record of which face it was.
+static unsigned char* serialize(const struct baker* b, int* size)
+{
+	unsigned char *out, *p;
+	int i, h = 0, nfonts = 0;
+
+	if (b->nrows)
+		h = b->rows[b->nrows-1].y + b->rows[b->nrows-1].h;
+	for (i = 0; i < MAX_FONTS; ++i)
+		if (b->fonts[i].data) ++nfonts;
+	*size = 20 + nfonts*12 + b->nrows*6 + b->nglyphs*28 + b->w*h;
+	out = (unsigned char*)malloc((size_t)*size);
+	if (!out) return NULL;
+
+	memcpy(out, "STHB", 4);
+	put32(out+4, BAKED_VERSION);
+	put16(out+8, (unsigned)b->w);
+	put16(out+10, (unsigned)h);
+	put16(out+12, (unsigned)b->nrows);
+	put16(out+14, (unsigned)nfonts);
+	put32(out+16, (unsigned)b->nglyphs);
+	p = out+20;
+	for (i = 0; i < MAX_FONTS; ++i)
+	{
+		const stbtt_fontinfo* font = &b->fonts[i].font;
+		if (!b->fonts[i].data) continue;
+		put16(p, (unsigned)i);
+		put16(p+2, (unsigned)font->numGlyphs);
+		put32(p+4, ttULONG(font->data + font->head + 8));
+		put32(p+8, (unsigned)font->fontstart);
+		p += 12;
+	}
+	for (i = 0; i < b->nrows; ++i, p += 6)
+	{
+		put16(p, (unsigned)b->rows[i].x);
+		put16(p+2, (unsigned)b->rows[i].y);
+		put16(p+4, (unsigned)b->rows[i].h);
+	}
+	for (i = 0; i < b->nglyphs; ++i, p += 28)
+	{
+		const struct bake_glyph* g = &b->glyphs[i];
+		put32(p, g->codepoint);
+		put16(p+4, (unsigned)g->slot);
+		put16(p+6, (unsigned short)g->size);
+		put16(p+8, (unsigned)g->x0);
+		put16(p+10, (unsigned)g->y0);
+		put16(p+12, (unsigned)g->x1);
+		put16(p+14, (unsigned)g->y1);
+		putf32(p+16, g->xadv);
+		putf32(p+20, g->xoff);
+		putf32(p+24, g->yoff);
+	}
+	memcpy(p, b->pixels, (size_t)(b->w*h));
+
+	return out;
+}
+
+static int write_source(FILE* fp, const char* name, const unsigned char* data, int size)
+{
+	int i;
+	fprintf(fp, "// Generated by sthbake; do not edit.\n\n");
+	fprintf(fp, "extern const unsigned char %s[];\n", name);
+	fprintf(fp, "extern const int %s_size;\n\n", name);
+	fprintf(fp, "const unsigned char %s[] =\n{", name);
+	for (i = 0; i < size; ++i)
+		fprintf(fp, "%s%d,", i % 24 ? "" : "\n\t", data[i]);
+	fprintf(fp, "\n};\n\n");
+	fprintf(fp, "const int %s_size = %d;\n", name, size);
+	return !ferror(fp);
+}
+
+static int ends_with(const char* s, const char* suffix)
+{
+	size_t n = strlen(s), m = strlen(suffix);
+	return n >= m && strcmp(s+n-m, suffix) == 0;
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: sthbake [-w width] [-h height] [-n name] -o output\n"
+					"               -f slot font [-s size,...] [-t text] [-r first-last] ...\n");
+}
+
+int main(int argc, char** argv)
+{
+	struct baker b;
+	const char* output = NULL;
+	const char* name = "baked_atlas";
+	unsigned char* data;
+	unsigned int first, last, c;
+	int i, size, ok = 1;
+	FILE* fp;
+
+	memset(&b, 0, sizeof(b));
+	b.w = b.h = 512;
+	b.nsizes = 1;
+	b.sizes[0] = 160;
+
+	// Size the atlas before anything is baked into it.
+	for (i = 1; i+1 < argc; ++i)
+	{
+		if (strcmp(argv[i], "-w") == 0) b.w = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-h") == 0) b.h = atoi(argv[++i]);
+	}
+	if (b.w <= 0 || b.h <= 0 || b.w > 0xffff || b.h > 0xffff)
+	{
+		usage();
+		return 1;
+	}
+	b.pixels = (unsigned char*)calloc((size_t)b.w, (size_t)b.h);
+	if (!b.pixels) return 1;
+
+	for (i = 1; i < argc && ok; ++i)
+	{
+		if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-h") == 0) && i+1 < argc)
+			++i;
+		else if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+			output = argv[++i];
+		else if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+			name = argv[++i];
+		else if (strcmp(argv[i], "-f") == 0 && i+2 < argc)
+		{
+			b.slot = atoi(argv[++i]);
+			++i;
+			if (b.slot < 0 || b.slot >= MAX_FONTS)
+			{
+				fprintf(stderr, "Font slot %d is out of range.\n", b.slot);
+				ok = 0;
+			}
+			else if (!b.fonts[b.slot].data)
+			{
+				b.fonts[b.slot].data = read_file(argv[i]);
+				if (!b.fonts[b.slot].data || !stbtt_InitFont(&b.fonts[b.slot].font, b.fonts[b.slot].data, 0))
+				{
+					fprintf(stderr, "Could not load font %s.\n", argv[i]);
+					ok = 0;
+				}
+			}
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+		{
+			if (!parse_sizes(&b, argv[++i]))
+			{
+				fprintf(stderr, "Bad size list %s.\n", argv[i]);
+				ok = 0;
+			}
+		}
+		else if (strcmp(argv[i], "-t") == 0 && i+1 < argc)
+			ok = bake_text(&b, argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i+1 < argc)
+		{
+			if (sscanf(argv[++i], "%x-%x", &first, &last) != 2 || first > last)
+			{
+				fprintf(stderr, "Bad range %s.\n", argv[i]);
+				ok = 0;
+			}
+			for (c = first; ok && c <= last; ++c)
+				ok = bake_codepoint(&b, c);
+		}
+		else
+		{
+			usage();
+			ok = 0;
+		}
+	}
+	if (ok && !output)
+	{
+		usage();
+		ok = 0;
+	}
+
+	data = ok ? serialize(&b, &size) : NULL;
+	if (data)
+	{
+		fp = fopen(output, ends_with(output, ".cpp") ? "w" : "wb");
+		if (!fp)
+			ok = 0;
+		else
+		{
+			if (ends_with(output, ".cpp"))
+				ok = write_source(fp, name, data, size);
+			else
+				ok = fwrite(data, 1, (size_t)size, fp) == (size_t)size;
+			if (fclose(fp) != 0) ok = 0;
+		}
+		if (!ok)
+			fprintf(stderr, "Could not write %s.\n", output);
+		else
+			printf("%s: %d glyphs, %dx%d atlas, %d bytes\n", output, b.nglyphs, b.w,
+				   b.nrows ? b.rows[b.nrows-1].y + b.rows[b.nrows-1].h : 0, size);
+		free(data);
+	}
+	else
+		ok = 0;
+
+	for (i = 0; i < MAX_FONTS; ++i)
+		free(b.fonts[i].data);
+	free(b.glyphs);
+	free(b.pixels);
+
+	return ok ? 0 : 1;
+}